@@ -0,0 +1,331 @@
+/*
+ * Proposal kernel microbenchmark.
+ *
+ * Builds a synthetic tissue of square cells on a medium, then times
+ * SquareCellGrid::moveCell exactly as simLoop drives it. Every heap
+ * allocation made during the timed region is counted by replacing the
+ * global operator new, and the benchmark fails if the kernel allocates.
+ * The adhesion energy kernel is then timed on its own against the
+ * per-type J vector lookup it replaced, and the proposal loop is timed
+ * again with the fixed-point Hamiltonian and its acceptance table.
+ *
+ * Usage: ProposalBench [width] [height] [mcs]
+ */
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/headers/CellType.h"
+#include "../src/headers/RandomNumberGenerators.h"
+#include "../src/headers/SquareCellGrid.h"
+#include "../src/headers/SuperCell.h"
+
+static std::atomic<unsigned long long> allocationCount(0);
+
+void *operator new(std::size_t n) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(n ? n : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t n) {
+	return operator new(n);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+// Adhesion matrix of default.cfg
+static const std::vector<std::vector<double>> benchJ = {
+	{0.0, 0.0, 1000000.0, 1000000.0, 1000000.0, 1000000.0, 1000000.0, 1000000.0, 1000000.0},
+	{0.0, 0.0, 0.0, 50.0, 50.0, 50.0, 50.0, 50.0, 50.0},
+	{1000000.0, 0.0, 0.0, 50.0, 50.0, 50.0, 50.0, 70.0, 30.0},
+	{1000000.0, 50.0, 50.0, 70.0, 40.0, 100.0, 100.0, 100.0, 100.0},
+	{1000000.0, 50.0, 50.0, 40.0, 35.0, 100.0, 100.0, 100.0, 100.0},
+	{1000000.0, 50.0, 50.0, 100.0, 100.0, 20.0, 70.0, 70.0, 100.0},
+	{1000000.0, 50.0, 50.0, 100.0, 100.0, 70.0, 20.0, 100.0, 100.0},
+	{1000000.0, 50.0, 70.0, 100.0, 100.0, 70.0, 100.0, 15.0, 20.0},
+	{1000000.0, 50.0, 30.0, 100.0, 100.0, 100.0, 100.0, 20.0, 15.0}};
+
+static const int CELL_SIDE = 16;
+
+std::shared_ptr<SquareCellGrid> buildBenchGrid(int width, int height) {
+
+	for (int t = 0; t < (int)benchJ.size(); t++) {
+
+		CellType T(t);
+		T.J = benchJ[t];
+		T.isStatic = (t == 0);
+		T.ignoreVolume = (t <= 1);
+		CellType::addType(T);
+	}
+
+	CellType::buildJTable();
+
+	int boundarySuper = SuperCell::makeNewSuperCell(0, 0, 0);
+	int spaceSuper = SuperCell::makeNewSuperCell(1, 0, 0);
+
+	auto grid = std::make_shared<SquareCellGrid>(width, height, boundarySuper, spaceSuper);
+
+	// Tile the central region with square cells of the non-medium types
+	int nextType = 2;
+	for (int y0 = height / 5; y0 + CELL_SIDE <= (4 * height) / 5; y0 += CELL_SIDE) {
+		for (int x0 = width / 5; x0 + CELL_SIDE <= (4 * width) / 5; x0 += CELL_SIDE) {
+
+			int c = SuperCell::makeNewSuperCell(nextType, 0, CELL_SIDE * CELL_SIDE);
+			nextType = (nextType + 1 < (int)benchJ.size()) ? nextType + 1 : 2;
+
+			for (int y = y0; y < y0 + CELL_SIDE; y++) {
+				for (int x = x0; x < x0 + CELL_SIDE; x++) {
+					grid->setCell(x + 1, y + 1, c);
+				}
+			}
+		}
+	}
+
+	grid->BOLTZ_TEMP = 20.0;
+	grid->OMEGA = 1.0;
+	grid->LAMBDA = 5.0;
+
+	return grid;
+}
+
+/**
+ * @brief Adhesion delta computed the way it was before the dense J table, through the
+ * per-type J vectors. Used as the reference for the kernel timing.
+ */
+double referenceAdhesionDelta(SquareCellGrid &grid, int destX, int destY, int sourceSuper) {
+
+	int destSuper = grid.getCell(destX, destY);
+
+	std::vector<double> &sourceJ = SuperCell::getJ(sourceSuper);
+	std::vector<double> &destJ = SuperCell::getJ(destSuper);
+
+	double initH = 0.0f;
+	double postH = 0.0f;
+
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+
+			if (x == 0 && y == 0)
+				continue;
+
+			int nSuper = grid.getCell(destX + x, destY + y);
+			int nType = SuperCell::getCellType(nSuper);
+
+			initH += destJ[nType] * (nSuper != destSuper);
+			postH += sourceJ[nType] * (nSuper != sourceSuper);
+		}
+	}
+
+	return (postH - initH);
+}
+
+/**
+ * @brief Time the adhesion energy kernel alone on every interface site of the grid
+ */
+void benchAdhesionKernel(SquareCellGrid &grid, int repeats) {
+
+	struct Copy {
+		int x, y, source;
+	};
+
+	std::vector<Copy> copies;
+
+	for (int y = 1; y <= grid.interiorHeight; y++) {
+		for (int x = 1; x <= grid.interiorWidth; x++) {
+
+			int c = grid.getCell(x, y);
+			int right = grid.getCell(x + 1, y);
+
+			if (c != right)
+				copies.push_back({x, y, right});
+		}
+	}
+
+	if (copies.empty())
+		return;
+
+	double checksum = 0.0;
+	double maxError = 0.0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (const Copy &C : copies) {
+			checksum += grid.getAdhesionDeltaAt(grid.index(C.x, C.y), C.source, grid.getCell(C.x, C.y));
+		}
+	}
+	auto mid = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (const Copy &C : copies) {
+			checksum -= referenceAdhesionDelta(grid, C.x, C.y, C.source);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	for (const Copy &C : copies) {
+		double delta = grid.getAdhesionDeltaAt(grid.index(C.x, C.y), C.source, grid.getCell(C.x, C.y)) - referenceAdhesionDelta(grid, C.x, C.y, C.source);
+		maxError = std::max(maxError, std::abs(delta));
+	}
+
+	double evaluations = (double)copies.size() * repeats;
+
+	std::cout << "Adhesion kernel (dense J, stride " << CellType::getJStride() << "): "
+			  << 1e9 * std::chrono::duration<double>(mid - start).count() / evaluations << " ns\n";
+	std::cout << "Adhesion kernel (per-type J vectors): "
+			  << 1e9 * std::chrono::duration<double>(end - mid).count() / evaluations << " ns\n";
+	std::cout << "Max kernel difference:  " << maxError << " (checksum " << checksum << ")\n";
+}
+
+/**
+ * @brief Time energy and acceptance alone, on every copy attempt across a cell interface, with
+ * the floating-point and the fixed-point Hamiltonian
+ */
+void benchAcceptance(SquareCellGrid &grid, int repeats) {
+
+	std::vector<std::pair<int, int>> attempts;
+
+	for (int y = 1; y <= grid.interiorHeight; y++) {
+		for (int x = 1; x <= grid.interiorWidth; x++) {
+
+			const int site = grid.index(x, y);
+
+			for (int n = 0; n < 8; n++) {
+				if (grid.canCopy(grid.getCellAt(site), grid.getCellAt(grid.neighbourOf(site, n))))
+					attempts.push_back({site, n});
+			}
+		}
+	}
+
+	if (attempts.empty())
+		return;
+
+	double seconds[2];
+	double checksum[2];
+
+	for (int mode = 0; mode < 2; mode++) {
+
+		grid.setIntegerEnergy(mode == 1);
+		checksum[mode] = 0.0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeats; r++) {
+			for (const auto &[site, n] : attempts) {
+				checksum[mode] += grid.getCopyProbability(site, n);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		seconds[mode] = std::chrono::duration<double>(end - start).count();
+	}
+
+	grid.setIntegerEnergy(false);
+
+	double evaluations = (double)attempts.size() * repeats;
+
+	std::cout << "Interface attempts:     " << attempts.size() << "\n";
+	std::cout << "Energy + acceptance (floating point): " << 1e9 * seconds[0] / evaluations << " ns\n";
+	std::cout << "Energy + acceptance (fixed point):    " << 1e9 * seconds[1] / evaluations << " ns\n";
+	std::cout << "Mean acceptance difference: " << (checksum[1] - checksum[0]) / evaluations << std::endl;
+}
+
+struct ProposalTiming {
+	unsigned long long proposals;
+	unsigned long long accepted;
+	unsigned long long allocations;
+	double seconds;
+};
+
+/**
+ * @brief Drive moveCell for a number of MCS exactly as simLoop does
+ */
+ProposalTiming timeProposals(SquareCellGrid &grid, int mcs) {
+
+	const unsigned long long iMCS = (unsigned long long)grid.interiorWidth * grid.interiorHeight;
+
+	ProposalTiming T = {iMCS * mcs, 0, 0, 0.0};
+
+	const unsigned long long allocsBefore = allocationCount.load();
+	auto start = std::chrono::steady_clock::now();
+
+	for (int m = 0; m < mcs; m++) {
+		for (unsigned long long i = 0; i < iMCS; i++) {
+
+			int x = RandomNumberGenerators::rUnifInt(1, grid.interiorWidth);
+			int y = RandomNumberGenerators::rUnifInt(1, grid.interiorHeight);
+
+			T.accepted += grid.moveCell(x, y);
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	T.allocations = allocationCount.load() - allocsBefore;
+	T.seconds = std::chrono::duration<double>(end - start).count();
+
+	return T;
+}
+
+void printTiming(const char *label, const ProposalTiming &T, int mcs) {
+
+	std::cout << label << "\n";
+	std::cout << "  Acceptance rate:        " << (double)T.accepted / T.proposals << "\n";
+	std::cout << "  ns per proposal:        " << 1e9 * T.seconds / T.proposals << "\n";
+	std::cout << "  MCS per second:         " << mcs / T.seconds << "\n";
+	std::cout << "  Allocations / proposal: " << (double)T.allocations / T.proposals << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+
+	int width = (argc > 1) ? std::stoi(argv[1]) : 200;
+	int height = (argc > 2) ? std::stoi(argv[2]) : 200;
+	int mcs = (argc > 3) ? std::stoi(argv[3]) : 200;
+
+	auto grid = buildBenchGrid(width, height);
+
+	RandomNumberGenerators::setSeed(1);
+
+	std::cout << "Grid:                   " << width << "x" << height << ", " << SuperCell::getNumSupers() << " SuperCells\n";
+	std::cout << "Proposals:              " << (unsigned long long)grid->interiorWidth * grid->interiorHeight * mcs << " (" << mcs << " MCS) per run\n";
+
+	// Let the tissue relax from its initial squares so both Hamiltonians see the same kind of state
+	timeProposals(*grid, mcs / 4);
+
+	ProposalTiming floating = timeProposals(*grid, mcs);
+	printTiming("Floating-point Hamiltonian", floating, mcs);
+
+	grid->setIntegerEnergy(true);
+	ProposalTiming fixed = timeProposals(*grid, mcs);
+	printTiming("Fixed-point Hamiltonian", fixed, mcs);
+
+	std::cout << "Fixed-point speedup:    " << floating.seconds / fixed.seconds << "x" << std::endl;
+
+	grid->setIntegerEnergy(false);
+	benchAdhesionKernel(*grid, 200);
+	benchAcceptance(*grid, 200);
+
+	return (floating.allocations + fixed.allocations == 0) ? 0 : 1;
+}
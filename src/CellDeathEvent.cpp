@@ -1,9 +1,9 @@
 #include "headers/CellDeathEvent.h"
+#include "headers/Registry.h"
 
 #include <iostream>
-#include <algorithm>
 
-static std::vector<CellDeathEvent> deathEvents = std::vector<CellDeathEvent>();
+static Registry<CellDeathEvent> deathEvents;
 
 CellDeathEvent::CellDeathEvent(int id) {
     this->id = id;
@@ -11,17 +11,12 @@ CellDeathEvent::CellDeathEvent(int id) {
 
 int CellDeathEvent::AddNewEvent(CellDeathEvent E) {
 
-    for(CellDeathEvent C : deathEvents) {
-        if(C.id == E.id) {
-            std::cout << "Warning: death event with ID " << E.id << " already defined. Skipping." << std::endl;
-        }
+    if(deathEvents.contains(E.id)) {
+        std::cout << "Warning: death event with ID " << E.id << " already defined. Skipping." << std::endl;
+        return -1;
     }
 
-    deathEvents.push_back(E);
-
-	std::sort(deathEvents.begin(), deathEvents.end(), [](const CellDeathEvent& lhs, const CellDeathEvent& rhs) {
-		return lhs.id < rhs.id;
-		});
+    deathEvents.add(E);
 
 	return 0;
 }
@@ -31,5 +26,9 @@ int CellDeathEvent::getNumEvents() {
 }
 
 CellDeathEvent& CellDeathEvent::getEvent(int e) {
-	return deathEvents[e];
+	return deathEvents.get(e);
+}
+
+bool CellDeathEvent::isDefined(int e) {
+	return deathEvents.contains(e);
 }
\ No newline at end of file
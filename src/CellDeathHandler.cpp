@@ -5,11 +5,14 @@
 #include "headers/SuperCell.h"
 
 #include <iostream>
-#include <unordered_set>
 #include <algorithm>
+#include <vector>
 
 static std::shared_ptr<SquareCellGrid> grid;
 
+// Cells of the targeted type, in ID order
+static std::vector<int> targets;
+
 void CellDeathHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr) {
 	grid = ptr;
 }
@@ -18,6 +21,9 @@ void CellDeathHandler::runDeathLoop(int m) {
 
 	for (int d = 0; d < CellDeathEvent::getNumEvents(); d++) {
 
+		if (!CellDeathEvent::isDefined(d))
+			continue;
+
 		CellDeathEvent &D = CellDeathEvent::getEvent(d);
 
 		if (m != 0 && m % D.fireOn == 0) {
@@ -25,11 +31,13 @@ void CellDeathHandler::runDeathLoop(int m) {
 			// Random probabilistic
 			if (D.type == 0) {
 
-				for (int c = 0; c < SuperCell::getNumSupers(); c++) {
+				SuperCell::getTypeMembersSorted(D.targetType, targets);
+
+				for (int c : targets) {
 
-					if (SuperCell::getCellType(c) == D.targetType && !SuperCell::isDead(c)) {
+					if (!SuperCell::isDead(c)) {
 
-						if (RandomNumberGenerators::rUnifProb() < D.data[0]) {
+						if (RandomNumberGenerators::rUnifProb(SuperCell::getID(c), RandomNumberGenerators::DEATH, d) < D.data[0]) {
 
 							SuperCell::setDead(c, true);
 						}
@@ -40,33 +48,16 @@ void CellDeathHandler::runDeathLoop(int m) {
 			// Neighbour weighted
 			if (D.type == 1) {
 
-				for (int c = 0; c < SuperCell::getNumSupers(); c++) {
-
-					if (SuperCell::getCellType(c) == (int)D.targetType) {
-
-						std::unordered_set<int> targetNeighbours;
+				SuperCell::getTypeMembersSorted((int)D.targetType, targets);
 
-						for (int y = 1; y <= grid->interiorHeight; y++) {
-							for (int x = 1; x <= grid->interiorWidth; x++) {
+				for (int c : targets) {
 
-								if (grid->getCell(x, y) == c) {
+					int targetNeighbours = grid->countNeighboursOfType(c, (int)D.data[0]);
 
-									auto N = grid->getNeighboursSuperCells(x, y);
+					double saturation = (double)(std::min((double)targetNeighbours,D.data[1]))/D.data[1];
+					double prob = saturation * D.data[2];
 
-									for (int nsc : N) {
-										if (SuperCell::getCellType(nsc) == (int)D.data[0])
-											targetNeighbours.insert(nsc);
-									}
-								}
-							}
-						}
-
-						double saturation = (double)(std::min((double)targetNeighbours.size(),D.data[1]))/D.data[1];
-						double prob = saturation * D.data[2];
-
-						if(RandomNumberGenerators::rUnifProb() < prob) SuperCell::setDead(c, true);
-
-					}
+					if(RandomNumberGenerators::rUnifProb(SuperCell::getID(c), RandomNumberGenerators::DEATH, d) < prob) SuperCell::setDead(c, true);
 				}
 			}
 		}
@@ -1,7 +1,8 @@
 #include "./headers/CellType.h"
+#include "./headers/Registry.h"
 #include <algorithm>
 
-static std::vector<CellType> cellTypes = std::vector<CellType>();
+static Registry<CellType> cellTypes;
 
 /**
  * @brief Construct a new CellType::CellType object
@@ -20,12 +21,7 @@ CellType::CellType(int id) {
  */
 void CellType::addType(CellType T) {
 
-	cellTypes.push_back(T);
-	
-	std::sort(cellTypes.begin(), cellTypes.end(), [](const CellType& lhs, const CellType& rhs) {
-		return lhs.id < rhs.id;
-		});
-
+	cellTypes.add(T);
 }
 
 /**
@@ -35,5 +31,40 @@ void CellType::addType(CellType T) {
  * @return reference to requested cell type
  */
 CellType& CellType::getType(int t) {
-	return cellTypes[t];
+	return cellTypes.get(t);
+}
+
+/**
+ * @brief Number of type slots, one more than the highest type ID added
+ */
+int CellType::getNumTypes() {
+	return cellTypes.size();
+}
+
+/**
+ * @brief Compile the J vectors of all cell types into the dense adhesion table.
+ * Must be called once every type has been added. Missing entries are treated as 0.
+ */
+void CellType::buildJTable() {
+
+	int numTypes = cellTypes.size();
+
+	// Pad rows so that common type counts get a compile-time stride
+	if (numTypes <= 8)
+		jStride = 8;
+	else if (numTypes <= 16)
+		jStride = 16;
+	else
+		jStride = (numTypes + 7) & ~7;
+
+	jTable.assign(jStride * std::max(numTypes, 1), 0.0);
+
+	for (int a = 0; a < numTypes; a++) {
+
+		std::vector<double> &J = cellTypes.get(a).J;
+
+		for (int b = 0; b < numTypes && b < (int)J.size(); b++) {
+			jTable[a * jStride + b] = J[b];
+		}
+	}
 }
\ No newline at end of file
@@ -1,26 +1,26 @@
-#include <algorithm>
-
 #include "./headers/ColourScheme.h"
 #include "./headers/RandomNumberGenerators.h"
+#include "./headers/Registry.h"
 
-static std::vector<ColourScheme> colourSchemes = std::vector<ColourScheme>();
+static Registry<ColourScheme> colourSchemes;
 
 /**
  * @brief Generate a new colour from the colour scheme with the provided ID
  * 
  * @param s ID of colour scheme to generate from
+ * @param c ID of the SuperCell being coloured, which keys counter-based draws
  * @return std::vector<int> Vector of integer colour values, [R,G,B,A]
  */
-std::vector<int> ColourScheme::generateColour(int s) {
+std::vector<int> ColourScheme::generateColour(int s, int c) {
 	std::vector<int> newCol = std::vector<int>(4, 255);
 
 	if (s == -1) return newCol;
 
-	ColourScheme& CS = colourSchemes[s];
+	ColourScheme& CS = colourSchemes.get(s);
 
-	newCol[0] = RandomNumberGenerators::rUnifInt(CS.rMin, CS.rMax);
-	newCol[1] = RandomNumberGenerators::rUnifInt(CS.gMin, CS.gMax);
-	newCol[2] = RandomNumberGenerators::rUnifInt(CS.bMin, CS.bMax);
+	newCol[0] = RandomNumberGenerators::rUnifInt(CS.rMin, CS.rMax, c, RandomNumberGenerators::COLOUR, 0);
+	newCol[1] = RandomNumberGenerators::rUnifInt(CS.gMin, CS.gMax, c, RandomNumberGenerators::COLOUR, 1);
+	newCol[2] = RandomNumberGenerators::rUnifInt(CS.bMin, CS.bMax, c, RandomNumberGenerators::COLOUR, 2);
 
 	newCol[3] = 255;
 
@@ -43,10 +43,5 @@ ColourScheme::ColourScheme(int id) {
  */
 void ColourScheme::addScheme(ColourScheme T) {
 
-	colourSchemes.push_back(T);
-
-	std::sort(colourSchemes.begin(), colourSchemes.end(), [](const ColourScheme& lhs, const ColourScheme& rhs) {
-		return lhs.id < rhs.id;
-		});
-
+	colourSchemes.add(T);
 }
\ No newline at end of file
@@ -1,21 +1,120 @@
 #include "./headers/DivisionHandler.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "./headers/SimClock.h"
 #include "./headers/SuperCell.h"
 
 static std::shared_ptr<SquareCellGrid> grid;
 
+// Division schedule: a min-heap of the SimClock time each cell is next due to divide. Entries are
+// never removed when a cell is rescheduled; each cell's newest entry carries its current stamp,
+// and entries with any other stamp are dropped when they reach the top.
+struct DivisionEntry {
+	std::int64_t due;
+	int cell;
+	std::uint64_t stamp;
+
+	bool operator>(const DivisionEntry &other) const {
+		return due > other.due;
+	}
+};
+
+static std::priority_queue<DivisionEntry, std::vector<DivisionEntry>, std::greater<DivisionEntry>> schedule;
+static std::vector<std::uint64_t> cellStamp;
+static std::uint64_t nextStamp = 0;
+
+// Compactions of the SuperCell table already accounted for
+static std::uint64_t seenCompactions = 0;
+
+static std::vector<int> rescheduled;
+static std::vector<int> dueCells;
+
 void DivisionHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr) {
 	grid = ptr;
+
+	schedule = {};
+	cellStamp.clear();
+	seenCompactions = SuperCell::getCompactions();
+}
+
+/**
+ * @brief Time at which a cell passes its division time. A cell divides once the MCS since its last
+ * division exceed its division time.
+ */
+static std::int64_t dueTime(int c) {
+	return (std::int64_t)SimClock::now() - SuperCell::getMCS(c) + SuperCell::getNextDiv(c) + 1;
+}
+
+/**
+ * @brief Give every cell whose division time may have changed a fresh entry, invalidating its old ones
+ */
+static void applyReschedules() {
+
+	// Compaction moves cells to new indices and puts every one of them in the rescheduled
+	// list, so the schedule is rebuilt from scratch
+	if (SuperCell::getCompactions() != seenCompactions) {
+		seenCompactions = SuperCell::getCompactions();
+		schedule = {};
+		cellStamp.clear();
+	}
+
+	SuperCell::takeRescheduled(rescheduled);
+
+	std::sort(rescheduled.begin(), rescheduled.end());
+	rescheduled.erase(std::unique(rescheduled.begin(), rescheduled.end()), rescheduled.end());
+
+	cellStamp.resize(SuperCell::getNumSupers(), 0);
+
+	for (int c : rescheduled) {
+
+		cellStamp[c] = ++nextStamp;
+
+		if (!SuperCell::isDead(c) && SuperCell::doDivide(c))
+			schedule.push({dueTime(c), c, cellStamp[c]});
+	}
 }
 
+/**
+ * @brief Divide every cell that has passed its division time. Only cells at the top of the
+ * schedule are looked at. Due cells are handled in ID order, as a scan over all cells would.
+ */
 void DivisionHandler::runDivisionLoop() {
-	for (int c = 0; c < SuperCell::getNumSupers(); c++) {
+
+	applyReschedules();
+
+	const int now = SimClock::now();
+
+	dueCells.clear();
+
+	while (!schedule.empty() && schedule.top().due <= now) {
+
+		const DivisionEntry E = schedule.top();
+		schedule.pop();
+
+		if (E.cell < (int)cellStamp.size() && cellStamp[E.cell] == E.stamp)
+			dueCells.push_back(E.cell);
+	}
+
+	std::sort(dueCells.begin(), dueCells.end());
+
+	for (int c : dueCells) {
 
 		if(SuperCell::isDead(c)) continue;
 
 		if (SuperCell::doDivide(c)) {
 
-			if (SuperCell::getMCS(c) > SuperCell::getNextDiv(c) && SuperCell::getVolume(c) >= SuperCell::getDivMinVol(c)) {
+			// Too small to divide yet, so check again next MCS
+			if (SuperCell::getVolume(c) < SuperCell::getDivMinVol(c)) {
+				schedule.push({now + 1, c, cellStamp[c]});
+				continue;
+			}
+
+			if (SuperCell::getMCS(c) > SuperCell::getNextDiv(c)) {
 
 				int dType = SuperCell::getDivType(c);
 				int newSuper = -1;
@@ -37,13 +136,16 @@ void DivisionHandler::runDivisionLoop() {
 
 					// std::cout << "Division at " << m << std::endl;
 
-					SuperCell::setNextDiv(newSuper, SuperCell::generateNewDivisionTime(c));
+					SuperCell::setNextDiv(newSuper, SuperCell::generateNewDivisionTime(newSuper));
 
 					SuperCell::generateNewColour(newSuper);
 				}
 
 				SuperCell::setNextDiv(c, SuperCell::generateNewDivisionTime(c));
+
+			} else {
+				schedule.push({dueTime(c), c, cellStamp[c]});
 			}
 		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,34 @@
+#include "./headers/LifecycleHandler.h"
+
+#include "./headers/SuperCell.h"
+
+static std::shared_ptr<SquareCellGrid> grid;
+
+// MCS between compactions of the SuperCell table, 0 to never compact
+static unsigned int compactInterval = 0;
+
+/**
+ * @brief Set up SuperCell retirement and compaction
+ *
+ * @param ptr Grid whose lattice holds the SuperCell IDs
+ * @param compactEvery MCS between compactions, 0 to only reuse freed slots
+ */
+void LifecycleHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int compactEvery) {
+	grid = ptr;
+	compactInterval = compactEvery;
+}
+
+/**
+ * @brief Retire dead cells that have lost all their sites, and compact the table when due, so
+ * that per-MCS loops over SuperCells only walk cells that still exist
+ *
+ * @param m Current MCS
+ */
+void LifecycleHandler::runLifecycleLoop(int m) {
+
+	SuperCell::retireDead();
+
+	if (compactInterval != 0 && m % compactInterval == 0 && SuperCell::getNumFree() > 0) {
+		grid->remapSuperCells(SuperCell::compact());
+	}
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <ctime>
@@ -6,7 +7,6 @@
 #include <iomanip>
 #include <iostream>
 #include <math.h>
-#include <mutex>
 #include <random>
 #include <stdlib.h>
 #include <thread>
@@ -24,6 +24,7 @@
 
 #include "./headers/CellDeathEvent.h"
 #include "./headers/CellDeathHandler.h"
+#include "./headers/LifecycleHandler.h"
 #include "./headers/CellType.h"
 #include "./headers/ColourScheme.h"
 #include "./headers/DivisionHandler.h"
@@ -31,15 +32,19 @@
 #include "./headers/RandomNumberGenerators.h"
 #include "./headers/ReportEvent.h"
 #include "./headers/ReportHandler.h"
+#include "./headers/SimClock.h"
+#include "./headers/SnapshotHandler.h"
+#include "./headers/TrajectoryHandler.h"
 #include "./headers/SquareCellGrid.h"
 #include "./headers/SuperCell.h"
 #include "./headers/SuperCellTemplate.h"
+#include "./headers/SweepHandler.h"
 #include "./headers/TransformEvent.h"
 #include "./headers/TransformHandler.h"
+#include "./headers/TripleBuffer.h"
 #include "./headers/Vector2D.h"
 #include "./headers/split.h"
 
-#include "./lib/TinyPngOut.hpp"
 #include "./lib/cxxopts.hpp"
 
 unsigned int PIXEL_SCALE = 4;
@@ -48,6 +53,33 @@ unsigned int SIM_DELAY = 0;
 unsigned int RENDER_FPS = 60;
 unsigned int IMAGE_LOAD_TYPE = 0;
 
+// 0: per-thread streams, 1: counter-based draws keyed by (seed, MCS, id, purpose)
+unsigned int RNG_MODE = 0;
+
+// 0: proposals from every interior site, 1: proposals from cell boundary sites only,
+// 2: rejection-free kinetic Monte Carlo
+unsigned int SWEEP_MODE = 0;
+
+// 0: floating point Hamiltonian, 1: fixed point with tabulated acceptance
+unsigned int ENERGY_MODE = 0;
+
+// Expected number of SuperCells over the run, reserved up front
+unsigned int CELL_CAPACITY = 0;
+
+// MCS between compactions of the SuperCell table, 0 to only reuse the slots of retired cells
+unsigned int COMPACT_EVERY = 0;
+
+// MCS between frames handed to the display
+unsigned int FRAME_EVERY = 1;
+
+// MCS between PNG snapshots, 0 for none, and threads encoding them
+unsigned int SNAPSHOT_EVERY = 0;
+unsigned int SNAPSHOT_THREADS = 1;
+
+// MCS between trajectory frames, 0 for none, and frames between trajectory keyframes
+unsigned int TRAJECTORY_EVERY = 0;
+unsigned int TRAJECTORY_KEYFRAME_EVERY = 100;
+
 double BOLTZ_TEMP = 10.0;
 double OMEGA = 1.0;
 double LAMBDA = 5.0;
@@ -60,39 +92,14 @@ int MCS_HOUR_EST = 500.0;
 bool AUTO_QUIT = false;
 bool HEADLESS = true;
 
-// Thread safety stuff
-std::mutex mData;
-std::mutex mNext;
-std::mutex mLowPriority;
-
-void highPriorityLock() {
-	mNext.lock();
-	mData.lock();
-	mNext.unlock();
-}
-
-void highPriorityUnlock() {
-	mData.unlock();
-}
-
-void lowPriorityLock() {
-	mLowPriority.lock();
-	mNext.lock();
-	mData.lock();
-	mNext.unlock();
-}
-
-void lowPriorityUnlock() {
-	mData.unlock();
-	mLowPriority.unlock();
-}
+// Frames published by the simulation thread and drawn by the display, without either waiting
+TripleBuffer<SquareCellGrid::LatticeFrame> frameBuffer;
 
 std::string logName;
 
 int simLoop(std::shared_ptr<SquareCellGrid> grid, std::atomic<bool> &done);
 unsigned int readConfig(std::string cfg);
 std::shared_ptr<SquareCellGrid> initializeGrid(std::string imgName);
-std::vector<uint8_t> stripAlpha(std::vector<uint8_t> pixelsIn);
 
 std::map<int, int> templateColourMap;
 
@@ -100,12 +107,20 @@ int main(int argc, char *argv[]) {
 
 	cxxopts::Options options("Pottchi", "CPM Software");
 
-	options.add_options()("h,headless", "Run in headless mode")("f,file", "File name to load", cxxopts::value<std::string>()->default_value("default"));
+	options.add_options()("h,headless", "Run in headless mode")("f,file", "File name to load", cxxopts::value<std::string>()->default_value("default"))("s,seed", "Random seed, taken from the clock if not given", cxxopts::value<uint64_t>())("t,threads", "Threads for the Monte Carlo sweep", cxxopts::value<unsigned int>()->default_value("1"));
 
 	auto result = options.parse(argc, argv);
 	std::string loadName = result["f"].as<std::string>();
 	HEADLESS = result["h"].as<bool>();
 
+	if (result.count("seed")) {
+		RandomNumberGenerators::setSeed(result["seed"].as<uint64_t>());
+	} else {
+		RandomNumberGenerators::setSeed(RandomNumberGenerators::getSeed());
+	}
+
+	std::cout << "Seed: " << RandomNumberGenerators::getSeed() << std::endl;
+
 #ifdef SSH_HEADLESS
 	HEADLESS = true;
 #endif
@@ -125,8 +140,10 @@ int main(int argc, char *argv[]) {
 
 	std::string fileName;
 
-	// Random number to add to filename to avoid conflicts
-	int randName = RandomNumberGenerators::rUnifInt(0, 1000);
+	// Random number to add to filename to avoid conflicts. Drawn outside the simulation
+	// generator, so runs sharing a seed do not share a name.
+	std::random_device nameDevice;
+	int randName = std::uniform_int_distribution<int>(0, 1000)(nameDevice);
 
 	// Try extra hard to avoid conflicts
 	int attempt = 0;
@@ -149,6 +166,10 @@ int main(int argc, char *argv[]) {
 	TransformHandler::initializeHandler(grid);
 	ReportHandler::initializeHandler(grid);
 	CellDeathHandler::initializeHandler(grid);
+	LifecycleHandler::initializeHandler(grid, COMPACT_EVERY);
+	SweepHandler::initializeHandler(grid, result["t"].as<unsigned int>(), SWEEP_MODE);
+	SnapshotHandler::initializeHandler(grid, SNAPSHOT_EVERY, SNAPSHOT_THREADS, fileName);
+	TrajectoryHandler::initializeHandler(grid, TRAJECTORY_EVERY, TRAJECTORY_KEYFRAME_EVERY, fileName);
 
 #ifndef SSH_HEADLESS
 	// Texture to render simulation to
@@ -157,13 +178,25 @@ int main(int argc, char *argv[]) {
 	sf::Sprite sprite(gridTexture);
 	sprite.setScale(PIXEL_SCALE, PIXEL_SCALE);
 
-	// Grid render method
+	// Pixels of the frame last drawn, and the rows recoloured since
+	std::vector<uint8_t> framePixels(grid->boundaryWidth * grid->boundaryHeight * 4);
+	std::vector<std::pair<int, int>> frameRows;
+	std::uint32_t frameEpoch = 0;
+
+	// Grid render method, drawing the newest frame the simulation has published. Only rows
+	// that changed since the last frame drawn are recoloured and uploaded.
 	auto refreshGridTexture = [&] {
-		highPriorityLock();
-		grid->fullTextureRefresh();
-		highPriorityUnlock();
-		uint8_t *pixels = grid->getPixels().data();
-		gridTexture.update(pixels);
+		if (frameBuffer.consume()) {
+
+			const SquareCellGrid::LatticeFrame &F = frameBuffer.front();
+
+			grid->colourFrame(F, framePixels.data(), frameEpoch, frameRows);
+			frameEpoch = F.epoch;
+
+			for (const auto &[first, count] : frameRows) {
+				gridTexture.update(framePixels.data() + (std::size_t)first * grid->boundaryWidth * 4, grid->boundaryWidth, count, 0, first);
+			}
+		}
 	};
 
 #endif
@@ -224,17 +257,19 @@ int main(int argc, char *argv[]) {
 
 #ifndef TINY_OUT
 #ifndef SSH_HEADLESS
+	grid->captureFrame(frameBuffer.back());
+	frameBuffer.publish();
 	refreshGridTexture();
 	gridTexture.copyToImage().saveToFile(fileName + ".png");
 #endif
 #endif
 
 #ifdef TINY_OUT
-	grid->fullTextureRefresh();
+	SquareCellGrid::LatticeFrame finalFrame;
+	grid->captureFrame(finalFrame);
+
 	std::ofstream tinyout(fileName + ".png", std::ios::binary);
-	;
-	TinyPngOut pngout(static_cast<uint32_t>(grid->boundaryWidth), static_cast<uint32_t>(grid->boundaryHeight), tinyout);
-	pngout.write(stripAlpha(grid->getPixels()).data(), grid->boundaryWidth * grid->boundaryHeight);
+	grid->writeFramePng(tinyout, finalFrame, std::max(1u, std::thread::hardware_concurrency()));
 #endif
 
 	// Clean up temporary file
@@ -247,42 +282,44 @@ int simLoop(std::shared_ptr<SquareCellGrid> grid, std::atomic<bool> &done) {
 
 	std::ofstream logFile(logName, std::ofstream::out);
 
-	// Number of samples to take before increasing MCS count
-	unsigned int iMCS = grid->interiorWidth * grid->interiorHeight;
+	// The simulation draws from its own stream, so GUI and headless runs of a seed match
+	RandomNumberGenerators::setThreadStream(1);
+
+	if (!HEADLESS) {
+		grid->captureFrame(frameBuffer.back());
+		frameBuffer.publish();
+	}
 
 	// Simulation loop
 	for (unsigned int m = 0; m < MAX_MCS; m++) {
 
-		if (!HEADLESS) {
-			lowPriorityLock();
-		}
-
-		if (done) {
-			lowPriorityUnlock();
+		if (done)
 			break;
-		}
-
-		// Monte Carlo Step
-		for (unsigned int i = 0; i < iMCS; i++) {
 
-			int x = RandomNumberGenerators::rUnifInt(1, grid->interiorWidth);
-			int y = RandomNumberGenerators::rUnifInt(1, grid->interiorHeight);
+		RandomNumberGenerators::setStep(m);
 
-			bool success = grid->moveCell(x, y);
-		}
+		// Monte Carlo Step
+		SweepHandler::runSweep();
 
 		CellDeathHandler::runDeathLoop(m);
 
+		// Free the slots of dead cells that have disappeared
+		LifecycleHandler::runLifecycleLoop(m);
+
 		// Cell division
 		DivisionHandler::runDivisionLoop();
 
 		// Transform Events
 		TransformHandler::runTransformLoop();
 
-		if (!HEADLESS) {
-			lowPriorityUnlock();
+		if (!HEADLESS && (m + 1) % FRAME_EVERY == 0) {
+			grid->captureFrame(frameBuffer.back());
+			frameBuffer.publish();
 		}
 
+		SnapshotHandler::runSnapshotLoop(m);
+		TrajectoryHandler::runTrajectoryLoop(m);
+
 		// Reporting
 		ReportHandler::runReportLoop(m, logFile);
 
@@ -292,15 +329,13 @@ int simLoop(std::shared_ptr<SquareCellGrid> grid, std::atomic<bool> &done) {
 			std::this_thread::sleep_for(std::chrono::milliseconds(SIM_DELAY));
 		*/
 
-		// Increase MCS count for each cell
-		SuperCell::increaseMCS();
-
-		// Update event timers
-		TransformEvent::updateTimers();
+		// Cell ages and event timers are read against this clock
+		SimClock::tick();
 	}
 
-	// Ensure Mutex unlock
-	lowPriorityUnlock();
+	SweepHandler::shutdownHandler();
+	SnapshotHandler::shutdownHandler();
+	TrajectoryHandler::shutdownHandler();
 
 	logFile.close();
 
@@ -353,6 +388,26 @@ unsigned int readConfig(std::string cfg) {
 				IMAGE_NAME = value;
 			else if (P == "IMAGE_TYPE")
 				IMAGE_LOAD_TYPE = stoi(value);
+			else if (P == "RNG_MODE")
+				RNG_MODE = stoi(value);
+			else if (P == "SWEEP_MODE")
+				SWEEP_MODE = stoi(value);
+			else if (P == "ENERGY_MODE")
+				ENERGY_MODE = stoi(value);
+			else if (P == "CELL_CAPACITY")
+				CELL_CAPACITY = stoi(value);
+			else if (P == "COMPACT_EVERY")
+				COMPACT_EVERY = stoi(value);
+			else if (P == "FRAME_EVERY")
+				FRAME_EVERY = std::max(stoi(value), 1);
+			else if (P == "SNAPSHOT_EVERY")
+				SNAPSHOT_EVERY = stoi(value);
+			else if (P == "SNAPSHOT_THREADS")
+				SNAPSHOT_THREADS = std::max(stoi(value), 1);
+			else if (P == "TRAJECTORY_EVERY")
+				TRAJECTORY_EVERY = stoi(value);
+			else if (P == "TRAJECTORY_KEYFRAME_EVERY")
+				TRAJECTORY_KEYFRAME_EVERY = std::max(stoi(value), 1);
 
 		}
 
@@ -573,7 +628,17 @@ unsigned int readConfig(std::string cfg) {
 
 	ifs.close();
 
+	CellType::buildJTable();
+
+	RandomNumberGenerators::setCounterMode(RNG_MODE == 1);
+
+	SuperCell::reserve(CELL_CAPACITY);
+
 	for (int e = 0; e < TransformEvent::getNumEvents(); e++) {
+
+		if (!TransformEvent::isDefined(e))
+			continue;
+
 		TransformEvent &T = TransformEvent::getEvent(e);
 
 		if (T.waitForOther == false) {
@@ -688,20 +753,7 @@ std::shared_ptr<SquareCellGrid> initializeGrid(std::string imgName) {
 	grid->OMEGA = OMEGA;
 	grid->LAMBDA = LAMBDA;
 
-	return grid;
-}
-
-std::vector<uint8_t> stripAlpha(std::vector<uint8_t> pixelsIn) {
+	grid->setIntegerEnergy(ENERGY_MODE == 1);
 
-	std::vector<uint8_t> pixelsOut;
-	pixelsOut.reserve((int)((pixelsIn.size() * 3) / 4));
-
-	for (int i = 0; i < pixelsIn.size(); i++) {
-
-		if ((i + 1) % 4 != 0) {
-			pixelsOut.push_back(pixelsIn[i]);
-		}
-	}
-
-	return pixelsOut;
+	return grid;
 }
\ No newline at end of file
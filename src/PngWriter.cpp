@@ -0,0 +1,445 @@
+#include "./headers/PngWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+// Deflate with the fixed Huffman code of RFC 1951. Each band of rows is one fixed block followed
+// by an empty stored block, which ends the band on a byte boundary, so bands compressed
+// separately can be joined into one stream. A final empty block closes the stream.
+
+static const int WINDOW = 32768;
+static const int MIN_MATCH = 3;
+static const int MAX_MATCH = 258;
+static const int HASH_BITS = 15;
+static const int MAX_CHAIN = 16;
+
+// Raw bytes per band, so that a band fills the deflate window
+static const int BAND_BYTES = 65536;
+
+static const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/**
+ * @brief Fixed Huffman codes, bit-reversed so they can be written least significant bit first
+ */
+struct FixedCodes {
+
+	std::array<std::uint16_t, 288> litCode;
+	std::array<std::uint8_t, 288> litBits;
+	std::array<std::uint8_t, MAX_MATCH + 1> lengthSymbol;
+
+	static std::uint16_t reverse(std::uint16_t code, int bits) {
+
+		std::uint16_t r = 0;
+		for (int b = 0; b < bits; b++) {
+			r = (r << 1) | ((code >> b) & 1);
+		}
+
+		return r;
+	}
+
+	FixedCodes() {
+
+		for (int s = 0; s < 288; s++) {
+
+			if (s < 144) {
+				litCode[s] = reverse(0x30 + s, 8);
+				litBits[s] = 8;
+			} else if (s < 256) {
+				litCode[s] = reverse(0x190 + s - 144, 9);
+				litBits[s] = 9;
+			} else if (s < 280) {
+				litCode[s] = reverse(s - 256, 7);
+				litBits[s] = 7;
+			} else {
+				litCode[s] = reverse(0xC0 + s - 280, 8);
+				litBits[s] = 8;
+			}
+		}
+
+		for (int k = 0; k < 29; k++) {
+			for (int len = LENGTH_BASE[k]; len <= MAX_MATCH && len < LENGTH_BASE[k] + (1 << LENGTH_EXTRA[k]); len++) {
+				lengthSymbol[len] = k;
+			}
+		}
+		lengthSymbol[MAX_MATCH] = 28;
+	}
+};
+
+static const FixedCodes codes;
+
+/**
+ * @brief Least significant bit first output, as deflate packs it
+ */
+struct BitWriter {
+
+	std::vector<uint8_t> &out;
+	std::uint64_t buffer = 0;
+	int count = 0;
+
+	void put(std::uint32_t bits, int n) {
+
+		buffer |= (std::uint64_t)bits << count;
+		count += n;
+
+		while (count >= 8) {
+			out.push_back((uint8_t)buffer);
+			buffer >>= 8;
+			count -= 8;
+		}
+	}
+
+	void align() {
+		if (count > 0)
+			put(0, 8 - count);
+	}
+
+	void literal(int s) {
+		put(codes.litCode[s], codes.litBits[s]);
+	}
+
+	void match(int length, int distance) {
+
+		const int l = codes.lengthSymbol[length];
+		literal(257 + l);
+		put(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+
+		int d = 0;
+		while (d < 29 && DIST_BASE[d + 1] <= distance) {
+			d++;
+		}
+
+		put(FixedCodes::reverse(d, 5), 5);
+		put(distance - DIST_BASE[d], DIST_EXTRA[d]);
+	}
+};
+
+static std::uint32_t adler32(const uint8_t *data, std::size_t size) {
+
+	std::uint32_t a = 1;
+	std::uint32_t b = 0;
+
+	while (size > 0) {
+
+		// Largest run that cannot overflow before the modulo
+		const std::size_t run = std::min<std::size_t>(size, 5552);
+
+		for (std::size_t k = 0; k < run; k++) {
+			a += data[k];
+			b += a;
+		}
+
+		a %= 65521;
+		b %= 65521;
+		data += run;
+		size -= run;
+	}
+
+	return (b << 16) | a;
+}
+
+/**
+ * @brief Adler-32 of two byte strings joined, from the checksum of each and the length of the second
+ */
+static std::uint32_t adler32Combine(std::uint32_t first, std::uint32_t second, std::size_t secondSize) {
+
+	const std::uint32_t BASE = 65521;
+	const std::uint32_t rem = (std::uint32_t)(secondSize % BASE);
+
+	std::uint32_t sum1 = first & 0xFFFF;
+	std::uint32_t sum2 = (std::uint32_t)(((std::uint64_t)rem * sum1) % BASE);
+
+	sum1 += (second & 0xFFFF) + BASE - 1;
+	sum2 += (first >> 16) + (second >> 16) + BASE - rem;
+
+	if (sum1 >= BASE)
+		sum1 -= BASE;
+	if (sum1 >= BASE)
+		sum1 -= BASE;
+	if (sum2 >= 2 * BASE)
+		sum2 -= 2 * BASE;
+	if (sum2 >= BASE)
+		sum2 -= BASE;
+
+	return (sum2 << 16) | sum1;
+}
+
+static std::uint32_t crc32(std::uint32_t crc, const uint8_t *data, std::size_t size) {
+
+	static const std::array<std::uint32_t, 256> table = [] {
+
+		std::array<std::uint32_t, 256> T;
+
+		for (std::uint32_t n = 0; n < 256; n++) {
+
+			std::uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+
+			T[n] = c;
+		}
+
+		return T;
+	}();
+
+	crc = ~crc;
+	for (std::size_t k = 0; k < size; k++) {
+		crc = table[(crc ^ data[k]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+static void putBigEndian(uint8_t *out, std::uint32_t v) {
+	out[0] = (uint8_t)(v >> 24);
+	out[1] = (uint8_t)(v >> 16);
+	out[2] = (uint8_t)(v >> 8);
+	out[3] = (uint8_t)v;
+}
+
+void PngWriter::writeChunk(std::ostream &out, const char *type, const uint8_t *data, std::size_t size) {
+
+	uint8_t header[8];
+	putBigEndian(header, (std::uint32_t)size);
+	std::memcpy(header + 4, type, 4);
+
+	std::uint32_t crc = crc32(0, header + 4, 4);
+	crc = crc32(crc, data, size);
+
+	uint8_t trailer[4];
+	putBigEndian(trailer, crc);
+
+	out.write((const char *)header, 8);
+	out.write((const char *)data, size);
+	out.write((const char *)trailer, 4);
+}
+
+/**
+ * @brief Filter and compress rows y0 to y1 - 1. Every row gets filter type 0: matches at a
+ * distance of one pixel or one row already find the runs and repeated rows that other filters
+ * would turn into zeros.
+ */
+void PngWriter::compressBand(int y0, int y1, int rowBytes, int pixelBytes, const RowSource &rows, Band &B) {
+
+	const int stride = rowBytes + 1;
+	const int size = (y1 - y0) * stride;
+
+	std::vector<uint8_t> raw(size);
+
+	for (int y = y0; y < y1; y++) {
+		raw[(y - y0) * stride] = 0;
+		rows(y, raw.data() + (y - y0) * stride + 1);
+	}
+
+	B.adler = adler32(raw.data(), size);
+	B.rawSize = size;
+	B.data.clear();
+	B.data.reserve(size / 8 + 64);
+
+	std::vector<int> head(1 << HASH_BITS, -1);
+	std::vector<int> prev(size, -1);
+
+	auto hash = [&](int i) {
+		return (int)(((raw[i] << 10) ^ (raw[i + 1] << 5) ^ raw[i + 2]) & ((1 << HASH_BITS) - 1));
+	};
+
+	auto insert = [&](int i) {
+		if (i + MIN_MATCH <= size) {
+			const int h = hash(i);
+			prev[i] = head[h];
+			head[h] = i;
+		}
+	};
+
+	auto matchLength = [&](int i, int candidate) {
+		const int limit = std::min(MAX_MATCH, size - i);
+		int len = 0;
+		while (len < limit && raw[candidate + len] == raw[i + len]) {
+			len++;
+		}
+		return len;
+	};
+
+	BitWriter W{B.data};
+
+	// Fixed Huffman block, not final
+	W.put(0b010, 3);
+
+	int i = 0;
+	while (i < size) {
+
+		int bestLength = 0;
+		int bestDistance = 0;
+
+		if (i + MIN_MATCH <= size) {
+
+			// Same pixel to the left and same byte in the row above come first, as they find
+			// runs of flat colour directly
+			for (int d : {pixelBytes, stride}) {
+				if (d <= i && d <= WINDOW) {
+					const int len = matchLength(i, i - d);
+					if (len > bestLength) {
+						bestLength = len;
+						bestDistance = d;
+					}
+				}
+			}
+
+			int candidate = head[hash(i)];
+			for (int chain = 0; chain < MAX_CHAIN && candidate != -1 && i - candidate <= WINDOW && bestLength < MAX_MATCH; chain++) {
+
+				const int len = matchLength(i, candidate);
+				if (len > bestLength) {
+					bestLength = len;
+					bestDistance = i - candidate;
+				}
+
+				candidate = prev[candidate];
+			}
+		}
+
+		if (bestLength >= MIN_MATCH) {
+
+			W.match(bestLength, bestDistance);
+
+			for (int k = 0; k < bestLength; k++) {
+				insert(i + k);
+			}
+			i += bestLength;
+
+		} else {
+
+			W.literal(raw[i]);
+			insert(i);
+			i++;
+		}
+	}
+
+	W.literal(256);
+
+	// Empty stored block to finish on a byte boundary
+	W.put(0b000, 3);
+	W.align();
+	W.put(0x0000, 16);
+	W.put(0xFFFF, 16);
+}
+
+/**
+ * @brief Write a whole PNG, one IDAT chunk per band
+ *
+ * @param out Stream to write to
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param colourType PNG colour type
+ * @param palette RGB entries of the PLTE chunk, empty for none
+ * @param rowBytes Bytes per row of raw samples
+ * @param pixelBytes Bytes per pixel, at least 1
+ * @param rows Source of rows
+ * @param threads Threads compressing bands, including the calling thread
+ */
+void PngWriter::writeImage(std::ostream &out, int width, int height, uint8_t colourType, const std::vector<uint8_t> &palette, int rowBytes, int pixelBytes, const RowSource &rows, unsigned int threads) {
+
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	out.write((const char *)signature, 8);
+
+	uint8_t header[13];
+	putBigEndian(header, width);
+	putBigEndian(header + 4, height);
+	header[8] = 8;
+	header[9] = colourType;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	writeChunk(out, "IHDR", header, 13);
+
+	if (!palette.empty())
+		writeChunk(out, "PLTE", palette.data(), palette.size());
+
+	const int bandRows = std::max(1, BAND_BYTES / (rowBytes + 1));
+	const int numBands = (height + bandRows - 1) / bandRows;
+
+	std::vector<Band> bands(numBands);
+	std::atomic<int> nextBand(0);
+
+	auto work = [&] {
+		for (int b = nextBand++; b < numBands; b = nextBand++) {
+			compressBand(b * bandRows, std::min(height, (b + 1) * bandRows), rowBytes, pixelBytes, rows, bands[b]);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threads && (int)t < numBands; t++) {
+		workers.emplace_back(work);
+	}
+
+	work();
+
+	for (std::thread &T : workers) {
+		T.join();
+	}
+
+	// zlib header: deflate with a 32K window, no dictionary, and the level marked fastest, as
+	// matching is greedy and only the fixed Huffman code is used
+	const uint8_t zlibHeader[2] = {0x78, 0x01};
+	bool first = true;
+	std::uint32_t adler = 1;
+
+	for (Band &B : bands) {
+
+		if (first) {
+			B.data.insert(B.data.begin(), zlibHeader, zlibHeader + 2);
+			first = false;
+		}
+
+		adler = adler32Combine(adler, B.adler, B.rawSize);
+		writeChunk(out, "IDAT", B.data.data(), B.data.size());
+	}
+
+	// Final empty fixed block, then the checksum of the raw data
+	std::vector<uint8_t> tail;
+	if (first)
+		tail.assign(zlibHeader, zlibHeader + 2);
+
+	BitWriter W{tail};
+	W.put(0b011, 3);
+	W.literal(256);
+	W.align();
+
+	uint8_t checksum[4];
+	putBigEndian(checksum, adler);
+	tail.insert(tail.end(), checksum, checksum + 4);
+
+	writeChunk(out, "IDAT", tail.data(), tail.size());
+	writeChunk(out, "IEND", nullptr, 0);
+}
+
+/**
+ * @brief Write an 8 bit RGB PNG with rows from a callback
+ */
+void PngWriter::writeRGB(std::ostream &out, int width, int height, const RowSource &rows, unsigned int threads) {
+	writeImage(out, width, height, 2, {}, width * 3, 3, rows, threads);
+}
+
+/**
+ * @brief Write an 8 bit RGB PNG from packed RGB pixels
+ */
+void PngWriter::writeRGB(std::ostream &out, int width, int height, const uint8_t *rgb, unsigned int threads) {
+	writeRGB(out, width, height, [&](int y, uint8_t *row) {
+		std::memcpy(row, rgb + (std::size_t)y * width * 3, (std::size_t)width * 3);
+	}, threads);
+}
+
+/**
+ * @brief Write an 8 bit indexed-colour PNG with rows of palette indices from a callback
+ *
+ * @param palette RGB triples, at most 256 of them
+ */
+void PngWriter::writeIndexed(std::ostream &out, int width, int height, const std::vector<uint8_t> &palette, const RowSource &rows, unsigned int threads) {
+	writeImage(out, width, height, 3, palette, width, 1, rows, threads);
+}
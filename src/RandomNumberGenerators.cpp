@@ -1,44 +1,170 @@
 #include "./headers/RandomNumberGenerators.h"
 
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <random>
 
-unsigned long long seed = std::chrono::system_clock::now().time_since_epoch().count();
+#include "./headers/MathConstants.h"
 
-static std::default_random_engine randGen((int)seed);
-static std::uniform_real_distribution<double> rUnif(0.0f, 1.0f);
+static std::atomic<std::uint64_t> seed(std::chrono::system_clock::now().time_since_epoch().count());
+
+// Next stream handed to a thread that draws without having been assigned one
+static std::atomic<unsigned int> nextStream(0);
+
+/**
+ * @brief Set the global seed, and restart the calling thread on stream 0 of it
+ *
+ * @param s Seed
+ */
+void RandomNumberGenerators::setSeed(std::uint64_t s) {
+	seed = s;
+	counterKey = {(std::uint32_t)s, (std::uint32_t)(s >> 32)};
+	nextStream = 1;
+	setThreadStream(0);
+}
+
+std::uint64_t RandomNumberGenerators::getSeed() {
+	return seed;
+}
 
 /**
- * @brief Generate a random uniform number between 0.0 and 1.0
+ * @brief Restart the calling thread's engine on an independent stream of the global seed.
+ * Threads that need reproducible draws should claim a fixed stream with this.
+ *
+ * @param stream Stream index
+ */
+void RandomNumberGenerators::setThreadStream(unsigned int stream) {
+	threadState.engine.seed(seed, stream);
+	threadState.seeded = true;
+}
+
+void RandomNumberGenerators::seedThread() {
+	setThreadStream(nextStream++);
+}
+
+/**
+ * @brief Generate a random normally distributed double
  *
+ * @param mu Mean
+ * @param stdev Standard deviation
  * @return double
  */
-double RandomNumberGenerators::rUnifProb() {
-	return rUnif(randGen);
+double RandomNumberGenerators::rNormalDouble(double mu, double stdev) {
+
+	std::normal_distribution<double> rNorm(mu, stdev);
+	return rNorm(engine());
 }
 
 /**
- * @brief Generate a random uniform integer between min and max
+ * @brief Fill an array with uniform integers between min and max, inclusive
  *
+ * @param out Array to fill
+ * @param n Number of values
  * @param min
  * @param max
+ */
+void RandomNumberGenerators::fillUnifInt(int *out, std::size_t n, int min, int max) {
+
+	Engine &E = engine();
+	const std::uint32_t range = (std::uint32_t)(max - min) + 1u;
+
+	for (std::size_t i = 0; i < n; i++) {
+		out[i] = min + (int)bounded(E, range);
+	}
+}
+
+/**
+ * @brief Fill an array with uniform numbers in [0.0, 1.0)
+ *
+ * @param out Array to fill
+ * @param n Number of values
+ */
+void RandomNumberGenerators::fillUnifProb(double *out, std::size_t n) {
+
+	Engine &E = engine();
+
+	for (std::size_t i = 0; i < n; i++) {
+		out[i] = (E() >> 11) * 0x1.0p-53;
+	}
+}
+
+
+/**
+ * @brief Switch keyed draws between the counter-based generator and the thread's stream.
+ * In counter mode every keyed draw is a pure function of (seed, MCS, id, purpose, draw),
+ * so results do not depend on the order or thread in which draws are made.
+ *
+ * @param on
+ */
+void RandomNumberGenerators::setCounterMode(bool on) {
+	counterMode = on;
+}
+
+/**
+ * @brief Set the MCS that keys counter-based draws
+ *
+ * @param mcs
+ */
+void RandomNumberGenerators::setStep(std::uint32_t mcs) {
+	step = mcs;
+}
+
+/**
+ * @brief Keyed uniform number in [0.0, 1.0)
+ *
+ * @param id SuperCell, site or event the draw belongs to
+ * @param p Purpose of the draw
+ * @param draw Index of the draw, when one key needs several
+ * @return double
+ */
+double RandomNumberGenerators::rUnifProb(std::uint32_t id, Purpose p, std::uint32_t draw) {
+
+	if (!counterMode)
+		return rUnifProb();
+
+	auto R = counterBlock(id, p, draw);
+	return ((((std::uint64_t)R[0] << 32) | R[1]) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * @brief Keyed uniform integer between min and max, inclusive
+ *
+ * @param min
+ * @param max
+ * @param id SuperCell, site or event the draw belongs to
+ * @param p Purpose of the draw
+ * @param draw Index of the draw, when one key needs several
  * @return int
  */
-int RandomNumberGenerators::rUnifInt(int min, int max) {
+int RandomNumberGenerators::rUnifInt(int min, int max, std::uint32_t id, Purpose p, std::uint32_t draw) {
 
-	std::uniform_int_distribution<int> rInt(min, max);
-	return rInt(randGen);
+	if (!counterMode)
+		return rUnifInt(min, max);
+
+	return wordToInt(counterBlock(id, p, draw)[0], min, max);
 }
 
 /**
- * @brief Generate a random normally distributed double
+ * @brief Keyed normally distributed double, by Box-Muller in counter mode
  *
  * @param mu Mean
  * @param stdev Standard deviation
+ * @param id SuperCell, site or event the draw belongs to
+ * @param p Purpose of the draw
+ * @param draw Index of the draw, when one key needs several
  * @return double
  */
-double RandomNumberGenerators::rNormalDouble(double mu, double stdev) {
+double RandomNumberGenerators::rNormalDouble(double mu, double stdev, std::uint32_t id, Purpose p, std::uint32_t draw) {
 
-	std::normal_distribution<double> rNorm(mu, stdev);
-	return rNorm(randGen);
+	if (!counterMode)
+		return rNormalDouble(mu, stdev);
+
+	auto R = counterBlock(id, p, draw);
+
+	// (0, 1] so that the logarithm is finite
+	double u1 = ((((std::uint64_t)R[0] << 32) | R[1]) >> 11) * 0x1.0p-53 + 0x1.0p-53;
+	double u2 = ((((std::uint64_t)R[2] << 32) | R[3]) >> 11) * 0x1.0p-53;
+
+	return mu + stdev * sqrt(-2.0 * log(u1)) * cos(2.0 * PI_D * u2);
 }
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "./headers/RejectionFreeSweep.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "./headers/FenwickTree.h"
+#include "./headers/RandomNumberGenerators.h"
+#include "./headers/SuperCell.h"
+
+// Rejection-free (n-fold way) sweep. Every copy attempt (source site, neighbour) is an event with
+// rate equal to its Metropolis acceptance probability. Each site's total rate is kept in a Fenwick
+// tree, so an accepted copy can be picked directly and time advanced by the number of Metropolis
+// proposals it would have taken to reach it.
+
+static std::shared_ptr<SquareCellGrid> grid;
+
+// Acceptance probability of each of the 8 copy attempts from each site, and their sum
+static std::vector<std::array<double, 8>> eventRates;
+static std::vector<double> siteRates;
+static FenwickTree rateTree;
+
+// Adhesion delta of each attempt. It only depends on the neighbourhood of the destination, so it
+// survives volume changes elsewhere.
+static std::vector<std::array<double, 8>> eventAdhesion;
+
+// Sites already recomputed in full, and sites whose sum needs updating, after the current event
+static std::vector<unsigned int> refreshStamp;
+static std::vector<unsigned int> dirtyStamp;
+static std::vector<int> dirtySites;
+static unsigned int currentStamp = 0;
+
+// State the rates were last computed against. Changes made outside the sweep (division, death,
+// transforms) force a full rebuild.
+static std::uint64_t seenLattice = ~0ull;
+static std::uint64_t seenCells = ~0ull;
+
+static void computeAttempt(int site, int n) {
+
+	const int dest = grid->neighbourOf(site, n);
+	const int origin = grid->getCellAt(site);
+	const int target = grid->getCellAt(dest);
+
+	if (!grid->canCopy(origin, target)) {
+		eventAdhesion[site][n] = 0.0;
+		eventRates[site][n] = 0.0;
+		return;
+	}
+
+	eventAdhesion[site][n] = grid->getCopyAdhesion(site, n);
+	eventRates[site][n] = grid->getCopyProbability(site, n, eventAdhesion[site][n]);
+}
+
+static double sumRates(int site) {
+
+	double rate = 0.0;
+
+	for (int n = 0; n < 8; n++) {
+		rate += eventRates[site][n];
+	}
+
+	return rate;
+}
+
+static void markDirty(int site) {
+
+	if (dirtyStamp[site] != currentStamp) {
+		dirtyStamp[site] = currentStamp;
+		dirtySites.push_back(site);
+	}
+}
+
+/**
+ * @brief Recompute all 8 attempts from a site, once per event
+ */
+static void refreshSite(int site) {
+
+	if (refreshStamp[site] == currentStamp || !grid->isInterior(site))
+		return;
+
+	refreshStamp[site] = currentStamp;
+
+	for (int n = 0; n < 8; n++) {
+		computeAttempt(site, n);
+	}
+
+	markDirty(site);
+}
+
+/**
+ * @brief Recompute one attempt after a volume change, reusing its adhesion delta, unless its
+ * site has already been recomputed in full
+ */
+static void refreshAttempt(int site, int n) {
+
+	if (refreshStamp[site] == currentStamp || !grid->isInterior(site))
+		return;
+
+	eventRates[site][n] = grid->getCopyProbability(site, n, eventAdhesion[site][n]);
+	markDirty(site);
+}
+
+static void rebuildRates() {
+
+	std::fill(eventRates.begin(), eventRates.end(), std::array<double, 8>{});
+	std::fill(eventAdhesion.begin(), eventAdhesion.end(), std::array<double, 8>{});
+	std::fill(siteRates.begin(), siteRates.end(), 0.0);
+
+	for (int k = 0; k < grid->getNumBoundarySites(); k++) {
+
+		const int site = grid->getBoundarySite(k);
+
+		for (int n = 0; n < 8; n++) {
+			computeAttempt(site, n);
+		}
+
+		siteRates[site] = sumRates(site);
+	}
+
+	rateTree.build(siteRates);
+}
+
+/**
+ * @brief Refresh every rate a copy of origin over target at dest can have changed. The adhesion
+ * term of an attempt reads the neighbourhood of its destination, so attempts from within two
+ * sites of dest are affected. The volume term reads the volumes of both SuperCells, so every
+ * attempt from or into either of them is affected too.
+ */
+static void refreshAfterCopy(int dest, int origin, int target) {
+
+	currentStamp++;
+
+	for (int n = 0; n < 8; n++) {
+
+		const int near = grid->neighbourOf(dest, n);
+
+		// Every interior site two steps from dest can be reached through an interior site, and
+		// frame sites may have no neighbours on the lattice
+		if (!grid->isInterior(near))
+			continue;
+
+		for (int m = 0; m < 8; m++) {
+			refreshSite(grid->neighbourOf(near, m));
+		}
+		refreshSite(near);
+	}
+	refreshSite(dest);
+
+	// Neighbour 7 - n is the reverse of neighbour n, so an attempt into a site from its neighbour
+	// is found without searching
+	for (int c : {origin, target}) {
+
+		if (SuperCell::ignoreVolume(c))
+			continue;
+
+		for (int site = grid->firstCellBoundarySite(c); site != -1; site = grid->nextCellBoundarySite(site)) {
+			for (int n = 0; n < 8; n++) {
+
+				const int other = grid->neighbourOf(site, n);
+
+				if (grid->getCellAt(other) != c) {
+					refreshAttempt(site, n);
+					refreshAttempt(other, 7 - n);
+				}
+			}
+		}
+	}
+
+	for (int site : dirtySites) {
+
+		const double rate = sumRates(site);
+		rateTree.add(site, rate - siteRates[site]);
+		siteRates[site] = rate;
+	}
+
+	dirtySites.clear();
+}
+
+/**
+ * @brief Set up the rejection-free sweep
+ *
+ * @param ptr Grid to sweep
+ */
+void RejectionFreeSweep::initializeHandler(std::shared_ptr<SquareCellGrid> ptr) {
+
+	grid = ptr;
+
+	const int sites = grid->rowStride * grid->boundaryHeight;
+
+	eventRates.assign(sites, {});
+	eventAdhesion.assign(sites, {});
+	siteRates.assign(sites, 0.0);
+	refreshStamp.assign(sites, 0);
+	dirtyStamp.assign(sites, 0);
+}
+
+/**
+ * @brief Run one MCS. With a per-proposal acceptance probability of P = total rate / (8 * sites),
+ * the number of Metropolis proposals up to and including the next accepted one is geometric, so
+ * accepted copies are made until those numbers add up to one MCS.
+ */
+void RejectionFreeSweep::runSweep() {
+
+	if (grid->getLatticeRevision() != seenLattice || SuperCell::getRevision() != seenCells) {
+		rebuildRates();
+	} else {
+		rateTree.build(siteRates);
+	}
+
+	const double iMCS = (double)grid->interiorWidth * grid->interiorHeight;
+	double consumed = 0.0;
+
+	for (unsigned int k = 0;; k++) {
+
+		const double total = rateTree.total();
+
+		if (total <= 0.0)
+			break;
+
+		double skip;
+		double pickSite;
+		double pickNeighbour;
+
+		if (RandomNumberGenerators::isCounterMode()) {
+
+			auto R = RandomNumberGenerators::counterBlock(k, RandomNumberGenerators::PROPOSAL);
+
+			skip = RandomNumberGenerators::wordToProb(R[0]) + 0x1.0p-32;
+			pickSite = RandomNumberGenerators::wordToProb(R[1]);
+			pickNeighbour = RandomNumberGenerators::wordToProb(R[2]);
+
+		} else {
+
+			skip = 1.0 - RandomNumberGenerators::rUnifProb();
+			pickSite = RandomNumberGenerators::rUnifProb();
+			pickNeighbour = RandomNumberGenerators::rUnifProb();
+		}
+
+		const double p = total / (8.0 * iMCS);
+		consumed += (p < 1.0) ? std::floor(std::log(skip) / std::log1p(-p)) + 1.0 : 1.0;
+
+		if (consumed > iMCS)
+			break;
+
+		const int site = rateTree.find(pickSite * total);
+
+		// Choose the neighbour in proportion to its acceptance probability
+		const std::array<double, 8> &probs = eventRates[site];
+		const double siteTotal = siteRates[site];
+
+		// Only possible through rounding at the very end of the tree
+		if (siteTotal <= 0.0)
+			continue;
+
+		int neighbour = 0;
+		double u = pickNeighbour * siteTotal;
+
+		for (int n = 0; n < 8; n++) {
+			if (probs[n] > 0.0) {
+				neighbour = n;
+				if (u < probs[n])
+					break;
+				u -= probs[n];
+			}
+		}
+
+		const int dest = grid->neighbourOf(site, neighbour);
+		const int originSuper = grid->getCellAt(site);
+		const int targetSuper = grid->getCellAt(dest);
+
+		// An acceptance draw of 0 accepts any copy with non-zero probability
+		grid->moveCellAt(site, neighbour, 0.0);
+
+		refreshAfterCopy(dest, originSuper, targetSuper);
+	}
+
+	seenLattice = grid->getLatticeRevision();
+	seenCells = SuperCell::getRevision();
+}
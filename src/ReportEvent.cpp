@@ -1,8 +1,7 @@
-#include <algorithm>
-
 #include "./headers/ReportEvent.h"
+#include "./headers/Registry.h"
 
-static std::vector<ReportEvent> reportEvents = std::vector<ReportEvent>();
+static Registry<ReportEvent> reportEvents;
 
 /**
  * @brief Construct a new Report object
@@ -29,7 +28,18 @@ int ReportEvent::getNumEvents() {
  * @return Reference to requested report
  */
 ReportEvent &ReportEvent::getEvent(int r) {
-	return reportEvents[r];
+	return reportEvents.get(r);
+}
+
+/**
+ * @brief Whether a report was defined with this ID. IDs below getNumEvents() that were skipped in
+ * the config hold placeholders that must not run.
+ *
+ * @param r Requested ID
+ * @return bool
+ */
+bool ReportEvent::isDefined(int r) {
+	return reportEvents.contains(r);
 }
 
 /**
@@ -39,11 +49,7 @@ ReportEvent &ReportEvent::getEvent(int r) {
  * @return Return 0 if successful
  */
 int ReportEvent::addNewEvent(ReportEvent R) {
-	reportEvents.push_back(R);
-
-	std::sort(reportEvents.begin(), reportEvents.end(), [](const ReportEvent &lhs, const ReportEvent &rhs) {
-		return lhs.id < rhs.id;
-	});
+	reportEvents.add(R);
 
 	return 0;
 }
\ No newline at end of file
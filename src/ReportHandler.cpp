@@ -17,6 +17,9 @@ void ReportHandler::runReportLoop(int m, std::ofstream& logFile) {
 
     for (int r = 0; r < ReportEvent::getNumEvents(); r++) {
 
+			if (!ReportEvent::isDefined(r))
+				continue;
+
 			ReportEvent &R = ReportEvent::getEvent(r);
 
 			bool isFired = R.fired;
@@ -38,12 +41,7 @@ void ReportHandler::runReportLoop(int m, std::ofstream& logFile) {
 				// Count all countable cells
 				if (R.type == 1) {
 
-					int cellCount = 0;
-
-					for (int s = 0; s < SuperCell::getNumSupers(); s++) {
-						if(SuperCell::isDead(s)) continue;
-						cellCount += SuperCell::isCountable(s);
-					}
+					int cellCount = SuperCell::getLiveCountable();
 
 					logFile << R.reportText << "," << m << "," << cellCount << "\n";
 
@@ -58,40 +56,25 @@ void ReportHandler::runReportLoop(int m, std::ofstream& logFile) {
 					int typeA = stoi(R.data[0]);
 					int typeB = stoi(R.data[1]);
 
-					for (int y = 1; y <= grid->interiorHeight; y++) {
-
-						for (int x = 1; x <= grid->interiorWidth; x++) {
-
-							if (SuperCell::getCellType(grid->getCell(x, y)) == typeA) {
-
-								std::vector<int> neighbourTypes = grid->getNeighboursTypes(x, y);
+					for (int s : SuperCell::getTypeMembers(typeA)) {
 
-								if (std::find(neighbourTypes.begin(), neighbourTypes.end(), typeB) != neighbourTypes.end()) {
+						if (grid->bordersType(s, typeB)) {
 
-									logFile << R.reportText << "," << m << "\n";
-
-									if (!R.doRepeat) {
-										R.fired = true;
-									}
+							logFile << R.reportText << "," << m << "\n";
 
-									goto endLoop;
-								}
+							if (!R.doRepeat) {
+								R.fired = true;
 							}
+
+							break;
 						}
 					}
-
-				endLoop:;
 				}
 
 				// Count all cells of a specific type
 				if (R.type == 3) {
 
-					int cellCount = 0;
-
-					for (int s = 0; s < SuperCell::getNumSupers(); s++) {
-						if(SuperCell::isDead(s)) continue;
-						cellCount += SuperCell::getCellType(s) == stoi(R.data[0]);
-					}
+					int cellCount = SuperCell::getLiveCount(stoi(R.data[0]));
 
 					logFile << R.reportText << "," << m << "," << cellCount << "\n";
 				}
@@ -102,51 +85,27 @@ void ReportHandler::runReportLoop(int m, std::ofstream& logFile) {
 					int typeA = stoi(R.data[0]);
 					int typeB = stoi(R.data[1]);
 
-					std::map<int, bool> listOfTypeASupers;
-
-					for (int s = 0; s < SuperCell::getNumSupers(); s++) {
-						if (SuperCell::getCellType(s) == typeA && !SuperCell::isDead(s)) {
-							listOfTypeASupers[s] = false;
-						}
-					}
+					// Never fires once every cell of the type has died
+					if (SuperCell::getLiveCount(typeA) > 0) {
 
-					if (listOfTypeASupers.empty())
-						goto emptyMap;
+						for (int s : SuperCell::getTypeMembers(typeA)) {
 
-					for (int y = 1; y <= grid->interiorHeight; y++) {
+							// While any are alive, dead cells count until they have left the lattice
+							if (SuperCell::isDead(s) && grid->firstCellSite(s) == -1)
+								continue;
 
-						for (int x = 1; x <= grid->interiorWidth; x++) {
+							if (!grid->bordersType(s, typeB)) {
 
-							int sc = grid->getCell(x, y);
+								logFile << R.reportText << "," << m << "\n";
 
-							if (SuperCell::getCellType(sc) == typeA) {
-
-								if (listOfTypeASupers[sc] == true)
-									continue;
-
-								std::vector<int> neighbourTypes = grid->getNeighboursTypes(x, y);
-
-								if (std::find(neighbourTypes.begin(), neighbourTypes.end(), typeB) != neighbourTypes.end()) {
-									listOfTypeASupers[sc] = true;
+								if (!R.doRepeat) {
+									R.fired = true;
 								}
-							}
-						}
-					}
-
-					for (auto neighbourStatusPair : listOfTypeASupers) {
-						if (neighbourStatusPair.second == false) {
 
-							logFile << R.reportText << "," << m << "\n";
-
-							if (!R.doRepeat) {
-								R.fired = true;
+								break;
 							}
-
-							break;
 						}
 					}
-
-				emptyMap:;
 				}
 
 				// Count cells of type 0 is touching type 1
@@ -155,25 +114,13 @@ void ReportHandler::runReportLoop(int m, std::ofstream& logFile) {
 					int typeA = stoi(R.data[0]);
 					int typeB = stoi(R.data[1]);
 
-					std::vector<int> confirmedSupers;
-
-					for (int y = 1; y <= grid->interiorHeight; y++) {
-
-						for (int x = 1; x <= grid->interiorWidth; x++) {
-
-							if (!(std::count(confirmedSupers.begin(), confirmedSupers.end(), grid->getCell(x, y))) && SuperCell::getCellType(grid->getCell(x, y)) == typeA) {
-
-								std::vector<int> neighbourTypes = grid->getNeighboursTypes(x, y);
-
-								if (std::find(neighbourTypes.begin(), neighbourTypes.end(), typeB) != neighbourTypes.end()) {
+					int cellCount = 0;
 
-									confirmedSupers.push_back(grid->getCell(x, y));
-								}
-							}
-						}
+					for (int s : SuperCell::getTypeMembers(typeA)) {
+						cellCount += grid->bordersType(s, typeB);
 					}
 
-					logFile << R.reportText << "," << m << "," << confirmedSupers.size() << "\n";
+					logFile << R.reportText << "," << m << "," << cellCount << "\n";
 
 					if (!R.doRepeat) {
 						R.fired = true;
@@ -185,21 +132,28 @@ void ReportHandler::runReportLoop(int m, std::ofstream& logFile) {
 
 					int type = stoi(R.data[0]);
 
-					int cellCount = 0;
+					int cellCount = SuperCell::getDeadCount(type);
+
+					logFile << R.reportText << "," << m << "," << cellCount << "\n";
+
+				}
+
+				// Export the contact graph: one line per pair of bordering cells, by external ID,
+				// with the neighbour pairs from the first into the second and back
+				if (R.type == 7) {
 
 					for (int s = 0; s < SuperCell::getNumSupers(); s++) {
-						if(!SuperCell::isDead(s)) continue;
+						for (const SquareCellGrid::Contact &C : grid->getContacts(s)) {
 
-						if(type == -1) {
-							cellCount++;
-							continue;
+							if (s < C.cell) {
+								logFile << R.reportText << "," << m << "," << SuperCell::getID(s) << "," << SuperCell::getID(C.cell) << "," << C.out << "," << C.in << "\n";
+							}
 						}
-
-						cellCount += SuperCell::getCellType(s) == type;
 					}
 
-					logFile << R.reportText << "," << m << "," << cellCount << "\n";
-
+					if (!R.doRepeat) {
+						R.fired = true;
+					}
 				}
 			}
 		}
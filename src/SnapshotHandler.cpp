@@ -0,0 +1,158 @@
+#include "./headers/SnapshotHandler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Periodic PNG snapshots. The simulation thread copies the lattice into a ring of frames, and
+// worker threads encode them, so the simulation only waits when every frame in the
+// ring is still queued for encoding.
+
+static std::shared_ptr<SquareCellGrid> grid;
+
+static unsigned int snapshotInterval = 0;
+static std::string snapshotName;
+
+struct Snapshot {
+	SquareCellGrid::LatticeFrame frame;
+	int mcs = 0;
+};
+
+// Frames, those free to capture into, and those captured and waiting for a worker
+static std::vector<Snapshot> ring;
+static std::vector<int> freeSlots;
+static std::deque<int> pending;
+
+static std::mutex ringLock;
+static std::condition_variable slotFreed;
+static std::condition_variable slotQueued;
+static bool stopping = false;
+
+static std::vector<std::thread> workers;
+
+static void encodeSnapshot(const Snapshot &S) {
+
+	std::ostringstream name;
+	name << snapshotName << "-" << std::setw(7) << std::setfill('0') << S.mcs << ".png";
+
+	std::ofstream out(name.str(), std::ios::binary);
+	grid->writeFramePng(out, S.frame, 1);
+}
+
+static void workerLoop() {
+
+	while (true) {
+
+		int slot;
+
+		{
+			std::unique_lock<std::mutex> lock(ringLock);
+			slotQueued.wait(lock, [] { return stopping || !pending.empty(); });
+
+			if (pending.empty())
+				return;
+
+			slot = pending.front();
+			pending.pop_front();
+		}
+
+		encodeSnapshot(ring[slot]);
+
+		{
+			std::lock_guard<std::mutex> lock(ringLock);
+			freeSlots.push_back(slot);
+		}
+
+		slotFreed.notify_one();
+	}
+}
+
+/**
+ * @brief Set up periodic snapshots
+ *
+ * @param ptr Grid to take snapshots of
+ * @param every MCS between snapshots, 0 for none
+ * @param threads Number of threads encoding snapshots
+ * @param baseName Snapshots are written to baseName-MCS.png
+ */
+void SnapshotHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int every, unsigned int threads, std::string baseName) {
+
+	grid = ptr;
+	snapshotInterval = every;
+	snapshotName = baseName;
+
+	if (snapshotInterval == 0)
+		return;
+
+	threads = std::max(1u, threads);
+
+	// Two frames per worker, so one can be captured while the other is encoded
+	ring.resize(2 * threads);
+	for (int s = (int)ring.size() - 1; s >= 0; s--) {
+		freeSlots.push_back(s);
+	}
+
+	for (unsigned int w = 0; w < threads; w++) {
+		workers.emplace_back(workerLoop);
+	}
+}
+
+/**
+ * @brief Queue a snapshot if one is due at the end of this MCS
+ *
+ * @param m Current MCS
+ */
+void SnapshotHandler::runSnapshotLoop(int m) {
+
+	if (snapshotInterval == 0 || (m + 1) % snapshotInterval != 0)
+		return;
+
+	int slot;
+
+	{
+		std::unique_lock<std::mutex> lock(ringLock);
+		slotFreed.wait(lock, [] { return !freeSlots.empty(); });
+
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+
+	// Only spans that changed since this frame was last used are copied
+	grid->captureFrame(ring[slot].frame);
+	ring[slot].mcs = m + 1;
+
+	{
+		std::lock_guard<std::mutex> lock(ringLock);
+		pending.push_back(slot);
+	}
+
+	slotQueued.notify_one();
+}
+
+/**
+ * @brief Write out every queued snapshot and join the worker threads
+ */
+void SnapshotHandler::shutdownHandler() {
+
+	if (workers.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(ringLock);
+		stopping = true;
+	}
+
+	slotQueued.notify_all();
+
+	for (std::thread &T : workers) {
+		T.join();
+	}
+
+	workers.clear();
+}
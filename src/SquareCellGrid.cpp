@@ -1,23 +1,20 @@
 #include "./headers/SquareCellGrid.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <math.h>
 #include <random>
 #include <vector>
 
 #include "./headers/MathConstants.h"
+#include "./headers/PngWriter.h"
 #include "./headers/RandomNumberGenerators.h"
 #include "./headers/SuperCell.h"
 
-std::vector<std::vector<int>> internalGrid;
-std::vector<uint8_t> pixels;
-
 SquareCellGrid::SquareCellGrid(int w, int h, int boundarySC, int spaceSC) {
 
-	internalGrid = std::vector<std::vector<int>>(w + 2, std::vector<int>(h + 2, spaceSC));
-	pixels = std::vector<uint8_t>((w + 2) * (h + 2) * 4);
-
 	// Temporary initialization
 	BOLTZ_TEMP = 0.0;
 	OMEGA = 0.0;
@@ -28,18 +25,803 @@ SquareCellGrid::SquareCellGrid(int w, int h, int boundarySC, int spaceSC) {
 	boundaryWidth = w + 2;
 	boundaryHeight = h + 2;
 
-	for (int x = 0; x < boundaryWidth; x++) {
-		internalGrid[x][0] = boundarySC;
-		internalGrid[x][boundaryHeight - 1] = boundarySC;
-	};
+	// Pad each row to a multiple of 16 sites (one cache line)
+	rowStride = (boundaryWidth + 15) & ~15;
 
-	for (int y = 0; y < boundaryHeight; y++) {
-		internalGrid[0][y] = boundarySC;
-		internalGrid[boundaryWidth - 1][y] = boundarySC;
-	};
+	lattice = std::vector<int, AlignedAllocator<int>>(rowStride * boundaryHeight, boundarySC);
+	pixels = std::vector<uint8_t>(boundaryWidth * boundaryHeight * 4);
+
+	for (int y = 1; y <= interiorHeight; y++) {
+		std::fill_n(lattice.begin() + index(1, y), interiorWidth, spaceSC);
+	}
+
+	int n = 0;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+
+			if (x == 0 && y == 0)
+				continue;
+
+			neighbourDX[n] = x;
+			neighbourDY[n] = y;
+			neighbourOffsets[n] = y * rowStride + x;
+			n++;
+		}
+	}
 
 	SuperCell::setVolume(spaceSC, interiorWidth * interiorHeight);
 	SuperCell::setVolume(boundarySC, (boundaryWidth * boundaryHeight) - (interiorWidth * interiorHeight));
+
+	rebuildBoundarySites();
+	rebuildCellSites();
+	rebuildContacts();
+	rebuildTypeSites();
+
+	// Rows are padded to a multiple of 16 sites, so spans never cross rows
+	spanEpoch.assign(lattice.size() / SPAN, frameEpoch);
+}
+
+/**
+ * @brief Recount the differing neighbours of every site and rebuild the boundary site list
+ */
+void SquareCellGrid::rebuildBoundarySites() {
+
+	neighbourDiffs.assign(lattice.size(), 0);
+	boundarySlot.assign(lattice.size(), -2);
+	boundarySites.clear();
+
+	// A site can only be on the boundary list once, so it never has to grow
+	boundarySites.reserve(interiorWidth * interiorHeight);
+
+	cellBoundaryHead.assign(SuperCell::getNumSupers(), -1);
+	cellBoundaryNext.assign(lattice.size(), -1);
+	cellBoundaryPrev.assign(lattice.size(), -2);
+
+	const int rows = (int)lattice.size() / rowStride;
+
+	for (int y = 0; y < rows; y++) {
+		for (int x = 0; x < rowStride; x++) {
+
+			const int i = index(x, y);
+			int diffs = 0;
+
+			for (int n = 0; n < 8; n++) {
+
+				const int nX = x + neighbourDX[n];
+				const int nY = y + neighbourDY[n];
+
+				if (nX >= 0 && nX < rowStride && nY >= 0 && nY < rows)
+					diffs += lattice[i + neighbourOffsets[n]] != lattice[i];
+			}
+
+			neighbourDiffs[i] = (uint8_t)diffs;
+		}
+	}
+
+	for (int y = 1; y <= interiorHeight; y++) {
+		for (int x = 1; x <= interiorWidth; x++) {
+
+			const int i = index(x, y);
+			boundarySlot[i] = -1;
+			updateBoundarySite(i);
+		}
+	}
+}
+
+/**
+ * @brief Add an interior site to, or remove it from, the boundary list to match its neighbour count
+ *
+ * @param i Lattice index
+ */
+void SquareCellGrid::updateBoundarySite(int i) {
+
+	int &slot = boundarySlot[i];
+
+	if (slot == -2)
+		return;
+
+	if (neighbourDiffs[i] != 0) {
+
+		if (slot == -1) {
+			slot = (int)boundarySites.size();
+			boundarySites.push_back(i);
+		}
+
+		if (cellBoundaryPrev[i] == -2) {
+
+			const int c = lattice[i];
+
+			if (c >= (int)cellBoundaryHead.size())
+				cellBoundaryHead.resize(c + 1, -1);
+
+			const int head = cellBoundaryHead[c];
+
+			cellBoundaryPrev[i] = -1;
+			cellBoundaryNext[i] = head;
+			if (head != -1)
+				cellBoundaryPrev[head] = i;
+			cellBoundaryHead[c] = i;
+		}
+
+	} else if (slot >= 0) {
+
+		// Swap with the last entry to remove in O(1)
+		const int last = boundarySites.back();
+		boundarySites[slot] = last;
+		boundarySlot[last] = slot;
+		boundarySites.pop_back();
+		slot = -1;
+
+		removeCellBoundarySite(i, lattice[i]);
+	}
+}
+
+/**
+ * @brief Remove a site from the boundary list of the SuperCell that owns it
+ *
+ * @param i Lattice index
+ * @param superCell Owner of the site when it was added
+ */
+void SquareCellGrid::removeCellBoundarySite(int i, int superCell) {
+
+	const int prev = cellBoundaryPrev[i];
+	const int next = cellBoundaryNext[i];
+
+	if (prev == -2)
+		return;
+
+	if (prev == -1)
+		cellBoundaryHead[superCell] = next;
+	else
+		cellBoundaryNext[prev] = next;
+
+	if (next != -1)
+		cellBoundaryPrev[next] = prev;
+
+	cellBoundaryPrev[i] = -2;
+	cellBoundaryNext[i] = -1;
+}
+
+/**
+ * @brief Renumber the SuperCells on the lattice after the table has been compacted, in one pass.
+ * The renumbering keeps distinct cells distinct, so boundary sites are unchanged and only the
+ * heads of the per-cell lists, the moment sums, the contact lists and the type blocks of cells move.
+ *
+ * @param remap New ID of each old ID, -1 for IDs no site holds
+ */
+void SquareCellGrid::remapSuperCells(const std::vector<int> &remap) {
+
+	for (int &site : lattice) {
+		site = remap[site];
+	}
+
+	std::vector<int> heads(SuperCell::getNumSupers(), -1);
+
+	for (int c = 0; c < (int)cellBoundaryHead.size() && c < (int)remap.size(); c++) {
+		if (remap[c] != -1)
+			heads[remap[c]] = cellBoundaryHead[c];
+	}
+
+	cellBoundaryHead.swap(heads);
+
+	std::fill(heads.begin(), heads.end(), -1);
+	heads.resize(SuperCell::getNumSupers(), -1);
+
+	for (int c = 0; c < (int)cellSiteHead.size() && c < (int)remap.size(); c++) {
+		if (remap[c] != -1)
+			heads[remap[c]] = cellSiteHead[c];
+	}
+
+	cellSiteHead.swap(heads);
+
+	std::vector<CellMoments> moments(SuperCell::getNumSupers());
+
+	for (int c = 0; c < (int)cellMoments.size() && c < (int)remap.size(); c++) {
+		if (remap[c] != -1)
+			moments[remap[c]] = cellMoments[c];
+	}
+
+	cellMoments.swap(moments);
+
+	std::vector<std::vector<Contact>> contacts(SuperCell::getNumSupers());
+	std::vector<int> self(SuperCell::getNumSupers(), 0);
+
+	for (int c = 0; c < (int)cellContacts.size() && c < (int)remap.size(); c++) {
+
+		if (remap[c] == -1)
+			continue;
+
+		for (Contact &C : cellContacts[c]) {
+			C.cell = remap[C.cell];
+		}
+
+		contacts[remap[c]].swap(cellContacts[c]);
+		self[remap[c]] = selfContacts[c];
+	}
+
+	cellContacts.swap(contacts);
+	selfContacts.swap(self);
+
+	std::vector<int> siteTypes(SuperCell::getNumSupers(), -1);
+
+	for (int c = 0; c < (int)cellSiteType.size() && c < (int)remap.size(); c++) {
+		if (remap[c] != -1)
+			siteTypes[remap[c]] = cellSiteType[c];
+	}
+
+	// Cells the grid has not seen yet hold no sites, so they can start out in the block of their type
+	for (int c = 0; c < (int)siteTypes.size(); c++) {
+		if (siteTypes[c] == -1) {
+			siteTypes[c] = SuperCell::getCellType(c);
+			addTypeBlocks(siteTypes[c]);
+		}
+	}
+
+	cellSiteType.swap(siteTypes);
+	latticeRevision++;
+
+	// The lattice and the palette are both renumbered, so every span is redrawn
+	std::fill(spanEpoch.begin(), spanEpoch.end(), frameEpoch);
+	capturedPalette.clear();
+}
+
+/**
+ * @brief Rebuild the site list of every SuperCell from the lattice
+ */
+void SquareCellGrid::rebuildCellSites() {
+
+	cellSiteHead.assign(SuperCell::getNumSupers(), -1);
+	cellSiteNext.assign(lattice.size(), -1);
+	cellSitePrev.assign(lattice.size(), -2);
+	cellMoments.assign(SuperCell::getNumSupers(), CellMoments());
+
+	// Added in reverse so that each list runs in lattice order
+	for (int y = interiorHeight; y >= 1; y--) {
+		for (int x = interiorWidth; x >= 1; x--) {
+			addCellSite(index(x, y), lattice[index(x, y)]);
+			addMoments(index(x, y), lattice[index(x, y)], 1);
+		}
+	}
+}
+
+/**
+ * @brief Add a site to, or with a sign of -1 remove it from, the moment sums of a SuperCell
+ *
+ * @param i Lattice index
+ * @param superCell SuperCell gaining or losing the site
+ * @param sign 1 or -1
+ */
+void SquareCellGrid::addMoments(int i, int superCell, int sign) {
+
+	if (superCell >= (int)cellMoments.size())
+		cellMoments.resize(superCell + 1);
+
+	const std::int64_t x = i % rowStride;
+	const std::int64_t y = i / rowStride;
+
+	CellMoments &M = cellMoments[superCell];
+	M.n += sign;
+	M.x += sign * x;
+	M.y += sign * y;
+	M.xx += sign * x * x;
+	M.yy += sign * y * y;
+	M.xy += sign * x * y;
+}
+
+/**
+ * @brief Rebuild the contact graph from the lattice
+ */
+void SquareCellGrid::rebuildContacts() {
+
+	cellContacts.assign(SuperCell::getNumSupers(), {});
+	selfContacts.assign(SuperCell::getNumSupers(), 0);
+
+	for (int y = 1; y <= interiorHeight; y++) {
+		for (int x = 1; x <= interiorWidth; x++) {
+
+			const int i = index(x, y);
+
+			for (int n = 0; n < 8; n++) {
+				addContacts(lattice[i], lattice[i + neighbourOffsets[n]], 1, 0);
+			}
+		}
+	}
+	// Leave room for neighbours to come and go without reallocating
+	for (std::vector<Contact> &list : cellContacts) {
+		list.reserve(2 * list.size() + 8);
+	}
+}
+
+/**
+ * @brief Change the number of neighbour pairs between interior sites of a and sites of b
+ *
+ * @param a First SuperCell
+ * @param b Second SuperCell
+ * @param dOut Change in pairs from a into b
+ * @param dIn Change in pairs from b into a
+ */
+void SquareCellGrid::addContacts(int a, int b, int dOut, int dIn) {
+
+	if (dOut == 0 && dIn == 0)
+		return;
+
+	const int size = std::max(a, b) + 1;
+
+	if (size > (int)cellContacts.size()) {
+
+		const int previous = (int)cellContacts.size();
+
+		cellContacts.resize(size);
+		selfContacts.resize(size, 0);
+
+		for (int c = previous; c < size; c++) {
+			cellContacts[c].reserve(16);
+		}
+	}
+
+	if (a == b) {
+		selfContacts[a] += dOut + dIn;
+		return;
+	}
+
+	// Entries are found by a linear search, as cells have few neighbours, and removed by swapping
+	// with the last, so lists keep their capacity and setCellAt rarely allocates
+	auto update = [](std::vector<Contact> &list, int other, int out, int in) {
+
+		size_t k = 0;
+		while (k < list.size() && list[k].cell != other) {
+			k++;
+		}
+
+		if (k == list.size())
+			list.push_back({other, 0, 0});
+
+		list[k].out += out;
+		list[k].in += in;
+
+		if (list[k].out == 0 && list[k].in == 0) {
+			list[k] = list.back();
+			list.pop_back();
+		}
+	};
+
+	update(cellContacts[a], b, dOut, dIn);
+	update(cellContacts[b], a, dIn, dOut);
+}
+
+/**
+ * @brief Move the neighbour pairs of a site from its old owner to its new one
+ *
+ * @param i Lattice index
+ * @param originalSuper Previous owner of the site
+ * @param superCell New owner of the site
+ */
+void SquareCellGrid::updateContacts(int i, int originalSuper, int superCell) {
+
+	const bool interior = boundarySlot[i] != -2;
+
+	// Pairs per neighbouring SuperCell, from this site and into it
+	int cells[8];
+	int fromSite[8];
+	int intoSite[8];
+	int distinct = 0;
+
+	for (int n = 0; n < 8; n++) {
+
+		const int j = i + neighbourOffsets[n];
+		const int other = lattice[j];
+
+		int k = 0;
+		while (k < distinct && cells[k] != other) {
+			k++;
+		}
+
+		if (k == distinct) {
+			cells[k] = other;
+			fromSite[k] = 0;
+			intoSite[k] = 0;
+			distinct++;
+		}
+
+		fromSite[k] += interior;
+		intoSite[k] += boundarySlot[j] != -2;
+	}
+
+	for (int k = 0; k < distinct; k++) {
+		addContacts(originalSuper, cells[k], -fromSite[k], -intoSite[k]);
+		addContacts(superCell, cells[k], fromSite[k], intoSite[k]);
+	}
+}
+
+/**
+ * @brief Number of Moore neighbour pairs from interior sites of a into sites of b
+ */
+int SquareCellGrid::getContactCount(int a, int b) const {
+
+	if (a == b)
+		return (a < (int)selfContacts.size()) ? selfContacts[a] : 0;
+
+	for (const Contact &C : getContacts(a)) {
+		if (C.cell == b)
+			return C.out;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Whether an interior site of c has a Moore neighbour of a cell type. Another site of c
+ * counts when c is of that type itself.
+ *
+ * @param c ID of SuperCell
+ * @param type ID of cell type
+ * @return bool
+ */
+bool SquareCellGrid::bordersType(int c, int type) const {
+
+	if (SuperCell::getCellType(c) == type && getContactCount(c, c) > 0)
+		return true;
+
+	for (const Contact &C : getContacts(c)) {
+		if (C.out > 0 && SuperCell::getCellType(C.cell) == type)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Number of distinct SuperCells of a cell type that interior sites of c border, c included
+ * when it is of that type itself
+ *
+ * @param c ID of SuperCell
+ * @param type ID of cell type
+ * @return int
+ */
+int SquareCellGrid::countNeighboursOfType(int c, int type) const {
+
+	int count = (SuperCell::getCellType(c) == type && getContactCount(c, c) > 0);
+
+	for (const Contact &C : getContacts(c)) {
+		count += (C.out > 0 && SuperCell::getCellType(C.cell) == type);
+	}
+
+	return count;
+}
+
+/**
+ * @brief First interior site of c in lattice order with a Moore neighbour of a cell type, found
+ * among the boundary sites of c unless c is of that type itself
+ *
+ * @param c ID of SuperCell
+ * @param type ID of cell type
+ * @return int Lattice index, or -1 if c does not border the type
+ */
+int SquareCellGrid::firstSiteBorderingType(int c, int type) const {
+
+	if (!bordersType(c, type))
+		return -1;
+
+	const bool self = SuperCell::getCellType(c) == type;
+	int first = -1;
+
+	for (int i = self ? firstCellSite(c) : firstCellBoundarySite(c); i != -1; i = self ? nextCellSite(i) : nextCellBoundarySite(i)) {
+
+		if (first != -1 && i > first)
+			continue;
+
+		for (int n = 0; n < 8; n++) {
+			if (SuperCell::getCellType(lattice[neighbourOf(i, n)]) == type) {
+				first = i;
+				break;
+			}
+		}
+	}
+
+	return first;
+}
+
+/**
+ * @brief Sort every interior site into the block of its SuperCell's type, in lattice order
+ */
+void SquareCellGrid::rebuildTypeSites() {
+
+	cellSiteType.clear();
+	typeSiteStart.assign(1, 0);
+	addTypeBlocks(CellType::getNumTypes() - 1);
+
+	for (int c = 0; c < SuperCell::getNumSupers(); c++) {
+		typeBlockOf(c);
+	}
+
+	std::vector<int> next(typeSiteStart.size(), 0);
+
+	for (int y = 1; y <= interiorHeight; y++) {
+		for (int x = 1; x <= interiorWidth; x++) {
+			next[cellSiteType[lattice[index(x, y)]] + 1]++;
+		}
+	}
+
+	for (int t = 1; t < (int)next.size(); t++) {
+		next[t] += next[t - 1];
+	}
+
+	typeSiteStart = next;
+	typeSites.assign(interiorWidth * interiorHeight, -1);
+	typeSitePos.assign(lattice.size(), -1);
+
+	for (int y = 1; y <= interiorHeight; y++) {
+		for (int x = 1; x <= interiorWidth; x++) {
+
+			const int i = index(x, y);
+			const int k = next[cellSiteType[lattice[i]]]++;
+
+			typeSites[k] = i;
+			typeSitePos[i] = k;
+		}
+	}
+}
+
+/**
+ * @brief Add empty blocks at the end of the site grouping, up to and including a type
+ */
+void SquareCellGrid::addTypeBlocks(int type) {
+
+	while ((int)typeSiteStart.size() <= type + 1) {
+		typeSiteStart.push_back(typeSiteStart.back());
+	}
+}
+
+/**
+ * @brief Block holding the sites of a SuperCell, starting out as its type when first seen
+ */
+int SquareCellGrid::typeBlockOf(int superCell) {
+
+	while ((int)cellSiteType.size() <= superCell) {
+
+		const int type = SuperCell::getCellType((int)cellSiteType.size());
+
+		addTypeBlocks(type);
+		cellSiteType.push_back(type);
+	}
+
+	return cellSiteType[superCell];
+}
+
+/**
+ * @brief Move a site from one type block to another, swapping it across each block boundary in
+ * between
+ *
+ * @param i Lattice index
+ * @param from Block holding the site
+ * @param to Block to move it to
+ */
+void SquareCellGrid::moveTypeSite(int i, int from, int to) {
+
+	int k = typeSitePos[i];
+
+	auto swapTo = [&](int edge) {
+		const int other = typeSites[edge];
+		typeSites[k] = other;
+		typeSitePos[other] = k;
+		typeSites[edge] = i;
+		typeSitePos[i] = edge;
+		k = edge;
+	};
+
+	// Onto the last slot of its block, which then becomes the first slot of the next
+	for (; from < to; from++) {
+		swapTo(typeSiteStart[from + 1] - 1);
+		typeSiteStart[from + 1]--;
+	}
+
+	// Onto the first slot of its block, which then becomes the last slot of the previous
+	for (; from > to; from--) {
+		swapTo(typeSiteStart[from]);
+		typeSiteStart[from]++;
+	}
+}
+
+/**
+ * @brief Move the sites of every SuperCell whose type has changed since they were grouped
+ */
+void SquareCellGrid::syncTypeSites() {
+
+	for (int c = 0; c < SuperCell::getNumSupers(); c++) {
+
+		const int from = typeBlockOf(c);
+		const int to = SuperCell::getCellType(c);
+
+		if (from == to)
+			continue;
+
+		addTypeBlocks(to);
+
+		for (int i = firstCellSite(c); i != -1; i = nextCellSite(i)) {
+			moveTypeSite(i, from, to);
+		}
+
+		cellSiteType[c] = to;
+	}
+}
+
+/**
+ * @brief Number of interior sites held by SuperCells of a type. Sites of the type are then
+ * available as getSiteOfType(type, 0) to getSiteOfType(type, count - 1), in no particular order.
+ *
+ * @param type ID of cell type
+ * @return int
+ */
+int SquareCellGrid::getNumSitesOfType(int type) {
+
+	syncTypeSites();
+
+	if (type < 0 || type + 1 >= (int)typeSiteStart.size())
+		return 0;
+
+	return typeSiteStart[type + 1] - typeSiteStart[type];
+}
+
+/**
+ * @brief Whether a site has a Moore neighbour of a cell type
+ *
+ * @param i Lattice index
+ * @param type ID of cell type
+ * @return bool
+ */
+bool SquareCellGrid::siteBordersType(int i, int type) const {
+
+	for (int n = 0; n < 8; n++) {
+		if (SuperCell::getCellType(lattice[neighbourOf(i, n)]) == type)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Every interior site of a cell type with a Moore neighbour of another type, in lattice
+ * order. Only cells bordering the other type are visited, and only their boundary sites unless
+ * the two types are the same.
+ *
+ * @param type ID of cell type of the sites
+ * @param other ID of cell type of the neighbour
+ * @param out Receives the lattice indices
+ */
+void SquareCellGrid::getSitesBorderingType(int type, int other, std::vector<int> &out) const {
+
+	out.clear();
+
+	const bool self = type == other;
+
+	for (int c : SuperCell::getTypeMembers(type)) {
+
+		if (!bordersType(c, other))
+			continue;
+
+		for (int i = self ? firstCellSite(c) : firstCellBoundarySite(c); i != -1; i = self ? nextCellSite(i) : nextCellBoundarySite(i)) {
+			if (siteBordersType(i, other))
+				out.push_back(i);
+		}
+	}
+
+	std::sort(out.begin(), out.end());
+}
+
+/**
+ * @brief Centroid, short axis gradient and ratio of the covariance eigenvalues of a SuperCell, in
+ * O(1) from its moment sums
+ *
+ * @param c ID of SuperCell, with at least one site
+ * @return CellShape
+ */
+SquareCellGrid::CellShape SquareCellGrid::getCellShape(int c) const {
+
+	const CellMoments M = getCellMoments(c);
+
+	double m00 = (double)M.n;
+
+	double xBar = (double)M.x / m00;
+	double yBar = (double)M.y / m00;
+
+	double mu20 = ((double)M.xx / m00) - pow(xBar, 2);
+	double mu02 = ((double)M.yy / m00) - pow(yBar, 2);
+	double mu11 = ((double)M.xy / m00) - xBar * yBar;
+
+	double covTrace = mu20 + mu02;
+	double covDet = mu20 * mu02 - pow(mu11, 2);
+
+	double eigA = (covTrace + sqrt(pow(covTrace, 2) - 4 * covDet)) / 2;
+	double eigB = (covTrace - sqrt(pow(covTrace, 2) - 4 * covDet)) / 2;
+
+	double smallEig = std::min(abs(eigA), abs(eigB));
+
+	Vector2D<double> eigVec(mu11, smallEig - mu20);
+
+	return {xBar, yBar, eigVec[1] / eigVec[0], std::max(abs(eigA), abs(eigB)) / std::min(abs(eigA), abs(eigB))};
+}
+
+/**
+ * @brief Push an interior site onto the front of the site list of a SuperCell
+ *
+ * @param i Lattice index
+ * @param superCell New owner of the site
+ */
+void SquareCellGrid::addCellSite(int i, int superCell) {
+
+	if (superCell >= (int)cellSiteHead.size())
+		cellSiteHead.resize(superCell + 1, -1);
+
+	const int head = cellSiteHead[superCell];
+
+	cellSitePrev[i] = -1;
+	cellSiteNext[i] = head;
+	if (head != -1)
+		cellSitePrev[head] = i;
+	cellSiteHead[superCell] = i;
+}
+
+/**
+ * @brief Remove a site from the site list of the SuperCell that owns it
+ *
+ * @param i Lattice index
+ * @param superCell Owner of the site when it was added
+ */
+void SquareCellGrid::removeCellSite(int i, int superCell) {
+
+	const int prev = cellSitePrev[i];
+	const int next = cellSiteNext[i];
+
+	if (prev == -2)
+		return;
+
+	if (prev == -1)
+		cellSiteHead[superCell] = next;
+	else
+		cellSiteNext[prev] = next;
+
+	if (next != -1)
+		cellSitePrev[next] = prev;
+
+	cellSitePrev[i] = -2;
+	cellSiteNext[i] = -1;
+}
+
+/**
+ * @brief Lattice indices of every site of a SuperCell, in lattice order, in O(volume)
+ *
+ * @param c ID of SuperCell
+ * @param out Receives the indices
+ */
+void SquareCellGrid::getCellSites(int c, std::vector<int> &out) const {
+
+	out.clear();
+
+	for (int i = firstCellSite(c); i != -1; i = nextCellSite(i)) {
+		out.push_back(i);
+	}
+
+	// The list is reordered as sites change hands. Division hands sites to the new cell in this
+	// order, which sets the order of the boundary site list and the per-type site blocks that the
+	// boundary sweep and spawn events draw from by index, so it is kept to that of a row-by-row
+	// scan for seeded runs to reproduce
+	std::sort(out.begin(), out.end());
+}
+
+/**
+ * @brief As getCellSites, as (x, y) coordinates
+ */
+void SquareCellGrid::getCellCoords(int c, std::vector<Vector2D<int>> &out) const {
+
+	std::vector<int> sites;
+	getCellSites(c, sites);
+
+	out.clear();
+	out.reserve(sites.size());
+
+	for (int i : sites) {
+		out.push_back(Vector2D<int>(i % rowStride, i / rowStride));
+	}
 }
 
 std::vector<Vector2D<int>> SquareCellGrid::getNeighboursCoords(int row, int col) {
@@ -47,13 +829,8 @@ std::vector<Vector2D<int>> SquareCellGrid::getNeighboursCoords(int row, int col)
 
 	neighbours.reserve(8);
 
-	for (int x = -1; x <= 1; x++) {
-		for (int y = -1; y <= 1; y++) {
-
-			if (x == 0 && y == 0)
-				continue;
-			neighbours.push_back(Vector2D<int>(row + x, col + y));
-		}
+	for (int n = 0; n < 8; n++) {
+		neighbours.push_back(Vector2D<int>(row + neighbourDX[n], col + neighbourDY[n]));
 	}
 	return neighbours;
 }
@@ -64,13 +841,9 @@ std::vector<int> SquareCellGrid::getNeighboursSuperCells(int row, int col) {
 
 	neighbours.reserve(8);
 
-	for (int x = -1; x <= 1; x++) {
-		for (int y = -1; y <= 1; y++) {
-
-			if (x == 0 && y == 0)
-				continue;
-			neighbours.push_back(internalGrid[row + x][col + y]);
-		}
+	const int i = index(row, col);
+	for (int n = 0; n < 8; n++) {
+		neighbours.push_back(lattice[i + neighbourOffsets[n]]);
 	}
 	return neighbours;
 }
@@ -81,14 +854,9 @@ std::vector<int> SquareCellGrid::getNeighboursTypes(int row, int col) {
 
 	neighbours.reserve(8);
 
-	for (int x = -1; x <= 1; x++) {
-		for (int y = -1; y <= 1; y++) {
-
-			if (x == 0 && y == 0)
-				continue;
-
-			neighbours.push_back(SuperCell::getCellType(internalGrid[row + x][col + y]));
-		}
+	const int i = index(row, col);
+	for (int n = 0; n < 8; n++) {
+		neighbours.push_back(SuperCell::getCellType(lattice[i + neighbourOffsets[n]]));
 	}
 	return neighbours;
 }
@@ -99,14 +867,10 @@ std::vector<Vector2D<int>> SquareCellGrid::getNeighboursCoords(int row, int col,
 
 	neighbours.reserve(8);
 
-	for (int x = -1; x <= 1; x++) {
-		for (int y = -1; y <= 1; y++) {
-
-			if (x == 0 && y == 0)
-				continue;
-			if (SuperCell::getCellType(internalGrid[row + x][col + y]) == type)
-				neighbours.push_back(Vector2D<int>(row + x, col + y));
-		}
+	const int i = index(row, col);
+	for (int n = 0; n < 8; n++) {
+		if (SuperCell::getCellType(lattice[i + neighbourOffsets[n]]) == type)
+			neighbours.push_back(Vector2D<int>(row + neighbourDX[n], col + neighbourDY[n]));
 	}
 	return neighbours;
 }
@@ -121,23 +885,21 @@ int SquareCellGrid::divideCell(int c) {
 	std::vector<Vector2D<int>> cellList;
 	std::vector<Vector2D<int>> newList;
 
-	for (int X = 1; X <= interiorWidth; X++) {
-		for (int Y = 1; Y <= interiorHeight; Y++) {
+	getCellCoords(c, cellList);
 
-			if (internalGrid[X][Y] == c) {
+	for (const Vector2D<int> &V : cellList) {
 
-				cellList.push_back(Vector2D<int>(X, Y));
+		const int X = V[0];
+		const int Y = V[1];
 
-				if (X < minX)
-					minX = X;
-				if (X > maxX)
-					maxX = X;
-				if (Y < minY)
-					minY = Y;
-				if (Y > maxY)
-					maxY = Y;
-			}
-		}
+		if (X < minX)
+			minX = X;
+		if (X > maxX)
+			maxX = X;
+		if (Y < minY)
+			minY = Y;
+		if (Y > maxY)
+			maxY = Y;
 	}
 
 	if (cellList.size() <= 1) {
@@ -185,23 +947,21 @@ int SquareCellGrid::divideCellRandomAxis(int c) {
 	std::vector<Vector2D<int>> cellList;
 	std::vector<Vector2D<int>> newList;
 
-	for (int X = 1; X <= interiorWidth; X++) {
-		for (int Y = 1; Y <= interiorHeight; Y++) {
+	getCellCoords(c, cellList);
 
-			if (internalGrid[X][Y] == c) {
+	for (const Vector2D<int> &V : cellList) {
 
-				cellList.push_back(Vector2D<int>(X, Y));
+		const int X = V[0];
+		const int Y = V[1];
 
-				if (X < minX)
-					minX = X;
-				if (X > maxX)
-					maxX = X;
-				if (Y < minY)
-					minY = Y;
-				if (Y > maxY)
-					maxY = Y;
-			}
-		}
+		if (X < minX)
+			minX = X;
+		if (X > maxX)
+			maxX = X;
+		if (Y < minY)
+			minY = Y;
+		if (Y > maxY)
+			maxY = Y;
 	}
 
 	if (cellList.size() <= 1) {
@@ -211,7 +971,7 @@ int SquareCellGrid::divideCellRandomAxis(int c) {
 	int midX = (int)(0.5 * (minX + maxX));
 	int midY = (int)(0.5 * (minY + maxY));
 
-	int gradM = RandomNumberGenerators::rUnifInt(-89, 89);
+	int gradM = RandomNumberGenerators::rUnifInt(-89, 89, SuperCell::getID(c), RandomNumberGenerators::DIVISION_AXIS);
 	double grad = tan(gradM * PI_D / 180.f);
 
 	for (unsigned int k = 0; k < cellList.size(); k++) {
@@ -239,49 +999,25 @@ int SquareCellGrid::divideCellShortAxis(int c) {
 	std::vector<Vector2D<int>> cellList;
 	std::vector<Vector2D<int>> newList;
 
-	// Find all subcells in cell
-	for (int X = 1; X <= interiorWidth; X++) {
-		for (int Y = 1; Y <= interiorHeight; Y++) {
-
-			if (internalGrid[X][Y] == c) {
-
-				cellList.push_back(Vector2D<int>(X, Y));
-			}
-		}
-	}
-
 	// Abort if cell less than one subcell
-	if (cellList.size() <= 1) {
+	if (getCellMoments(c).n <= 1) {
 		return -1;
 	}
 
-	// Calculate short axis of cell
-	double m00 = calculateRawImageMoment(cellList, 0, 0);
-	double m10 = calculateRawImageMoment(cellList, 1, 0);
-	double m01 = calculateRawImageMoment(cellList, 0, 1);
-
-	double xBar = m10 / m00;
-	double yBar = m01 / m00;
-
-	double mu20 = (calculateRawImageMoment(cellList, 2, 0) / m00) - pow(xBar, 2);
-	double mu02 = (calculateRawImageMoment(cellList, 0, 2) / m00) - pow(yBar, 2);
-	double mu11 = (calculateRawImageMoment(cellList, 1, 1) / m00) - xBar * yBar;
-
-	double covTrace = mu20 + mu02;
-	double covDet = mu20 * mu02 - pow(mu11, 2);
-
-	double eigA = (covTrace + sqrt(pow(covTrace, 2) - 4 * covDet)) / 2;
-	double eigB = (covTrace - sqrt(pow(covTrace, 2) - 4 * covDet)) / 2;
-
-	double smallEig = std::min(abs(eigA), abs(eigB));
+	// Short axis of cell, from its moments
+	const CellShape shape = getCellShape(c);
 
-	Vector2D<double> eigVec(mu11, smallEig - mu20);
-	double grad = eigVec[1] / eigVec[0];
+	const double xBar = shape.xBar;
+	const double yBar = shape.yBar;
+	const double grad = shape.shortAxisGrad;
 
 	int newSuperCell = -1;
 	double minRatio = SuperCell::getDivMinRatio(c);
 
-	if (std::max(abs(eigA), abs(eigB)) / std::min(abs(eigA), abs(eigB)) > minRatio) {
+	if (shape.elongation > minRatio) {
+
+		// Find all subcells in cell
+		getCellCoords(c, cellList);
 
 		for (unsigned int k = 0; k < cellList.size(); k++) {
 			if (cellList[k][1] > grad * (cellList[k][0] - xBar) + yBar) {
@@ -304,18 +1040,6 @@ int SquareCellGrid::divideCellShortAxis(int c) {
 	return newSuperCell;
 }
 
-double SquareCellGrid::calculateRawImageMoment(std::vector<Vector2D<int>> data, int iO, int jO) {
-
-	double moment = 0.0f;
-
-	for (Vector2D<int> V : data) {
-
-		moment += pow(V[0], iO) * pow(V[1], jO);
-	}
-
-	return moment;
-}
-
 int SquareCellGrid::cleaveCell(int c) {
 
 	int superCellA = c;
@@ -332,32 +1056,91 @@ int SquareCellGrid::cleaveCell(int c) {
 	return superCellB;
 }
 
-int SquareCellGrid::moveCell(int x, int y) {
+int SquareCellGrid::DirectCopy::volume(int c) const {
+	return SuperCell::getVolume(c);
+}
+
+void SquareCellGrid::DirectCopy::copy(int dest, int superCell) {
+	grid.setCellAt(dest, superCell);
+}
+
+/**
+ * @brief Volume of a SuperCell as seen from inside a tile: the volume at the start of the phase
+ * plus the changes this tile has made since
+ */
+int SquareCellGrid::JournalCopy::volume(int c) const {
+
+	int v = SuperCell::getVolume(c);
+
+	for (const auto &[cell, delta] : journal.volumeDelta) {
+		if (cell == c)
+			return v + delta;
+	}
+
+	return v;
+}
+
+void SquareCellGrid::JournalCopy::copy(int dest, int superCell) {
+
+	int &site = grid.lattice[dest];
+
+	journal.changes.push_back({dest, site, superCell});
+
+	bool foundOld = false;
+	bool foundNew = false;
+
+	for (auto &[cell, delta] : journal.volumeDelta) {
+		if (cell == site) {
+			delta--;
+			foundOld = true;
+		} else if (cell == superCell) {
+			delta++;
+			foundNew = true;
+		}
+	}
+
+	if (!foundOld)
+		journal.volumeDelta.push_back({site, -1});
+	if (!foundNew)
+		journal.volumeDelta.push_back({superCell, 1});
+
+	site = superCell;
+}
+
+/**
+ * @brief Attempt to copy the SuperCell at source into one of its neighbours
+ *
+ * @param source Lattice index of the copying site
+ * @param neighbour Index into the neighbour table of the site to overwrite
+ * @param acceptDraw Callable returning a uniform number in [0, 1), only invoked for unfavourable copies
+ * @param apply Copy policy, supplying SuperCell volumes and applying an accepted copy
+ * @return int 1 if the copy was accepted
+ */
+template <typename AcceptDraw, typename Copy>
+int SquareCellGrid::tryCopy(int source, int neighbour, AcceptDraw &&acceptDraw, Copy &&apply) {
 
-	std::vector<Vector2D<int>> neighbours = getNeighboursCoords(x, y);
+	const int dest = source + neighbourOffsets[neighbour];
 
-	int r = RandomNumberGenerators::rUnifInt(0, (int)neighbours.size() - 1);
+	const int origin = lattice[source];
+	const int target = lattice[dest];
 
-	int targetX = neighbours[r][0];
-	int targetY = neighbours[r][1];
+	if (canCopy(origin, target)) {
 
-	int origin = internalGrid[x][y];
-	int target = internalGrid[targetX][targetY];
+		bool accept;
 
-	if (!SuperCell::isStatic(target) &&
-		!SuperCell::isStatic(origin) &&
-		target != internalGrid[x][y] &&
-		!SuperCell::isDead(origin)) {
+		if (integerEnergy) {
 
-		double deltaH = 0;
+			const std::int64_t deltaH = copyDeltaHFixed(dest, origin, target, apply.volume(origin), apply.volume(target));
+			accept = (deltaH <= 0) || acceptFixed(deltaH, acceptDraw());
 
-		if (SuperCell::isDead(target)) {
-			deltaH = 0;
 		} else {
-			deltaH = getAdhesionDelta(x, y, targetX, targetY) * OMEGA + getVolumeDelta(x, y, targetX, targetY) * LAMBDA;
+
+			const double deltaH = copyDeltaH(dest, origin, target, apply.volume(origin), apply.volume(target));
+			accept = (deltaH <= 0) || (acceptDraw() < exp(-deltaH / BOLTZ_TEMP));
 		}
-		if (deltaH <= 0 || (RandomNumberGenerators::rUnifProb() < exp(-deltaH / BOLTZ_TEMP))) {
-			setCell(targetX, targetY, internalGrid[x][y]);
+
+		if (accept) {
+			apply.copy(dest, origin);
 
 			return 1;
 		}
@@ -366,95 +1149,606 @@ int SquareCellGrid::moveCell(int x, int y) {
 	return 0;
 }
 
-int SquareCellGrid::getCell(int row, int col) {
-	return internalGrid[row][col];
+/**
+ * @brief Energy change if origin copies itself over target at dest
+ *
+ * @param dest Lattice index of the site being overwritten
+ * @param origin SuperCell being copied
+ * @param target SuperCell occupying dest
+ * @param originVol Volume of origin
+ * @param targetVol Volume of target
+ * @return double
+ */
+double SquareCellGrid::copyDeltaH(int dest, int origin, int target, int originVol, int targetVol) const {
+
+	if (SuperCell::isDead(target))
+		return 0;
+
+	return copyDeltaH(origin, target, getAdhesionDeltaAt(dest, origin, target), originVol, targetVol);
+}
+
+/**
+ * @brief As above, with the adhesion delta already known
+ */
+double SquareCellGrid::copyDeltaH(int origin, int target, double adhesion, int originVol, int targetVol) const {
+
+	if (SuperCell::isDead(target))
+		return 0;
+
+	return adhesion * OMEGA + volumeDeltaKernel(origin, target, originVol, targetVol) * LAMBDA;
+}
+
+/**
+ * @brief Energy change if origin copies itself over target at dest, in fixed-point units
+ */
+std::int64_t SquareCellGrid::copyDeltaHFixed(int dest, int origin, int target, int originVol, int targetVol) const {
+
+	if (SuperCell::isDead(target))
+		return 0;
+
+	return copyDeltaHFixed(origin, target, adhesionDelta(jFixed.data(), dest, origin, target), originVol, targetVol);
+}
+
+/**
+ * @brief As above, with the fixed-point adhesion delta already known
+ */
+std::int64_t SquareCellGrid::copyDeltaHFixed(int origin, int target, std::int64_t adhesion, int originVol, int targetVol) const {
+
+	if (SuperCell::isDead(target))
+		return 0;
+
+	return adhesion + lambdaFixed * volumeDeltaSites(origin, target, originVol, targetVol);
+}
+
+/**
+ * @brief Adhesion delta of a copy attempt, in the units getCopyProbability expects: fixed-point
+ * when integer energies are on
+ *
+ * @param source Lattice index of the copying site
+ * @param neighbour Neighbour to copy into, 0 to 7
+ * @return double
+ */
+double SquareCellGrid::getCopyAdhesion(int source, int neighbour) const {
+
+	const int dest = source + neighbourOffsets[neighbour];
+
+	if (integerEnergy)
+		return (double)adhesionDelta(jFixed.data(), dest, lattice[source], lattice[dest]);
+
+	return getAdhesionDeltaAt(dest, lattice[source], lattice[dest]);
+}
+
+/**
+ * @brief Probability that a Metropolis attempt to copy source into the given neighbour is accepted
+ *
+ * @param source Lattice index of the copying site
+ * @param neighbour Neighbour to copy into, 0 to 7
+ * @return double
+ */
+double SquareCellGrid::getCopyProbability(int source, int neighbour) const {
+
+	const int dest = source + neighbourOffsets[neighbour];
+
+	const int origin = lattice[source];
+	const int target = lattice[dest];
+
+	if (!canCopy(origin, target))
+		return 0.0;
+
+	return getCopyProbability(source, neighbour, getCopyAdhesion(source, neighbour));
+}
+
+/**
+ * @brief As above, with the adhesion delta of the copy already known. Lets callers that cache
+ * adhesion deltas refresh a probability after a volume change without rescanning the neighbourhood.
+ *
+ * @param source Lattice index of the copying site
+ * @param neighbour Neighbour to copy into, 0 to 7
+ * @param adhesion Adhesion delta of the copy, from getCopyAdhesion
+ * @return double
+ */
+double SquareCellGrid::getCopyProbability(int source, int neighbour, double adhesion) const {
+
+	const int origin = lattice[source];
+	const int target = lattice[source + neighbourOffsets[neighbour]];
+
+	if (!canCopy(origin, target))
+		return 0.0;
+
+	if (integerEnergy) {
+
+		const std::int64_t deltaH = copyDeltaHFixed(origin, target, (std::int64_t)adhesion, SuperCell::getVolume(origin), SuperCell::getVolume(target));
+
+		if (deltaH <= 0)
+			return 1.0;
+
+		return (deltaH < (std::int64_t)acceptThreshold.size()) ? acceptThreshold[deltaH] * 0x1.0p-32 : 0.0;
+	}
+
+	double deltaH = copyDeltaH(origin, target, adhesion, SuperCell::getVolume(origin), SuperCell::getVolume(target));
+
+	return (deltaH <= 0) ? 1.0 : exp(-deltaH / BOLTZ_TEMP);
+}
+
+int SquareCellGrid::moveCell(int x, int y) {
+
+	return tryCopy(index(x, y), RandomNumberGenerators::rUnifInt(0, 7), [] {
+		return RandomNumberGenerators::rUnifProb();
+	}, DirectCopy{*this});
+}
+
+/**
+ * @brief Metropolis copy attempt with its random numbers already drawn
+ *
+ * @param x Source x
+ * @param y Source y
+ * @param neighbour Neighbour to copy into, 0 to 7
+ * @param accept Uniform number in [0, 1) for the acceptance test
+ * @return int 1 if the copy was accepted
+ */
+int SquareCellGrid::moveCell(int x, int y, int neighbour, double accept) {
+
+	return tryCopy(index(x, y), neighbour, [accept] {
+		return accept;
+	}, DirectCopy{*this});
+}
+
+/**
+ * @brief Metropolis copy attempt from a lattice index, with its random numbers already drawn
+ *
+ * @param site Lattice index of the source
+ * @param neighbour Neighbour to copy into, 0 to 7
+ * @param accept Uniform number in [0, 1) for the acceptance test
+ * @return int 1 if the copy was accepted
+ */
+int SquareCellGrid::moveCellAt(int site, int neighbour, double accept) {
+
+	return tryCopy(site, neighbour, [accept] {
+		return accept;
+	}, DirectCopy{*this});
+}
+
+/**
+ * @brief Metropolis copy attempt inside one tile of a parallel sweep. The lattice is written
+ * directly, but SuperCell volumes are left untouched and the copy is recorded in the journal.
+ * Tiles processed concurrently must be far enough apart that their neighbourhoods never meet.
+ *
+ * @param x Source x
+ * @param y Source y
+ * @param neighbour Neighbour to copy into, 0 to 7
+ * @param accept Uniform number in [0, 1) for the acceptance test
+ * @param J Journal of the tile
+ * @return int 1 if the copy was accepted
+ */
+int SquareCellGrid::moveCellInTile(int x, int y, int neighbour, double accept, TileJournal &J) {
+
+	return tryCopy(index(x, y), neighbour, [accept] {
+		return accept;
+	}, JournalCopy{*this, J});
+}
+
+/**
+ * @brief As above, drawing from the calling thread's random stream
+ */
+int SquareCellGrid::moveCellInTile(int x, int y, TileJournal &J) {
+
+	return tryCopy(index(x, y), RandomNumberGenerators::rUnifInt(0, 7), [] {
+		return RandomNumberGenerators::rUnifProb();
+	}, JournalCopy{*this, J});
+}
+
+/**
+ * @brief Apply the copies of a tile through setCellAt, in the order they were made, then clear
+ * the journal. The lattice is first rolled back so that setCellAt sees every change exactly as
+ * a serial sweep would have.
+ *
+ * @param J Journal of the tile
+ */
+void SquareCellGrid::commitTile(TileJournal &J) {
+
+	for (auto it = J.changes.rbegin(); it != J.changes.rend(); ++it) {
+		lattice[it->site] = it->previous;
+	}
+
+	for (const TileJournal::Change &C : J.changes) {
+		setCellAt(C.site, C.next);
+	}
+
+	J.changes.clear();
+	J.volumeDelta.clear();
 }
 
 void SquareCellGrid::setCell(int x, int y, int superCell) {
+	setCellAt(index(x, y), superCell);
+}
 
-	int originalSuper = internalGrid[x][y];
+void SquareCellGrid::setCellAt(int i, int superCell) {
+
+	int &site = lattice[i];
+	int originalSuper = site;
 
 	// Volume Change
 	SuperCell::changeVolume(originalSuper, -1);
 	SuperCell::changeVolume(superCell, 1);
 
-	internalGrid[x][y] = superCell;
+	site = superCell;
+	latticeRevision++;
+	spanEpoch[i / SPAN] = frameEpoch;
+
+	if (originalSuper == superCell)
+		return;
+
+	removeCellBoundarySite(i, originalSuper);
+
+	if (boundarySlot[i] != -2) {
+		removeCellSite(i, originalSuper);
+		addCellSite(i, superCell);
+		addMoments(i, originalSuper, -1);
+		addMoments(i, superCell, 1);
+		moveTypeSite(i, typeBlockOf(originalSuper), typeBlockOf(superCell));
+	}
+
+	updateContacts(i, originalSuper, superCell);
+
+	// Each neighbour pair whose match changed updates the counts of both sites
+	for (int n = 0; n < 8; n++) {
+
+		const int j = i + neighbourOffsets[n];
+		const int other = lattice[j];
+		const int change = (other != superCell) - (other != originalSuper);
+
+		if (change != 0) {
+			neighbourDiffs[i] += change;
+			neighbourDiffs[j] += change;
+			updateBoundarySite(j);
+		}
+	}
+
+	updateBoundarySite(i);
 }
 
 double SquareCellGrid::getAdhesionDelta(int sourceX, int sourceY, int destX, int destY) {
 
-	int sourceSuper = internalGrid[sourceX][sourceY];
-	int destSuper = internalGrid[destX][destY];
+	const int dest = index(destX, destY);
+	return getAdhesionDeltaAt(dest, lattice[index(sourceX, sourceY)], lattice[dest]);
+}
+
+/**
+ * @brief Change in adhesion energy if the site at dest is copied over by sourceSuper
+ *
+ * @param dest Lattice index of the site being overwritten
+ * @param sourceSuper SuperCell being copied into dest
+ * @param destSuper SuperCell currently occupying dest
+ * @return double
+ */
+double SquareCellGrid::getAdhesionDeltaAt(int dest, int sourceSuper, int destSuper) const {
+	return adhesionDelta(CellType::getJTable(), dest, sourceSuper, destSuper);
+}
+
+/**
+ * @brief Adhesion delta against a dense J table laid out like CellType's, dispatched on its stride
+ */
+template <typename T>
+T SquareCellGrid::adhesionDelta(const T *J, int dest, int sourceSuper, int destSuper) const {
+
+	switch (CellType::getJStride()) {
+	case (8):
+		return adhesionDeltaKernel<8>(J, dest, sourceSuper, destSuper);
+	case (16):
+		return adhesionDeltaKernel<16>(J, dest, sourceSuper, destSuper);
+	default:
+		return adhesionDeltaKernel<0>(J, dest, sourceSuper, destSuper);
+	}
+}
 
-	std::vector<double> &sourceJ = SuperCell::getJ(sourceSuper);
-	std::vector<double> &destJ = SuperCell::getJ(destSuper);
+/**
+ * @brief Adhesion delta over the Moore neighbourhood of dest. STRIDE is the row length of the
+ * dense J table when known at compile time, or 0 to read it at runtime.
+ */
+template <int STRIDE, typename T>
+T SquareCellGrid::adhesionDeltaKernel(const T *J, int dest, int sourceSuper, int destSuper) const {
 
-	double initH = 0.0f;
-	double postH = 0.0f;
+	const int stride = STRIDE ? STRIDE : CellType::getJStride();
 
-	auto neighbours = getNeighboursCoords(destX, destY);
+	const T *sourceJ = J + SuperCell::getCellType(sourceSuper) * stride;
+	const T *destJ = J + SuperCell::getCellType(destSuper) * stride;
 
-	for (int i = 0; i < 8; i++) {
+	int nSuper[8];
+	int nType[8];
+
+	for (int n = 0; n < 8; n++) {
+		nSuper[n] = lattice[dest + neighbourOffsets[n]];
+		nType[n] = SuperCell::getCellType(nSuper[n]);
+	}
 
-		int nSuper = internalGrid[neighbours[i][0]][neighbours[i][1]];
-		int nType = SuperCell::getCellType(nSuper);
+	T initH = 0;
+	T postH = 0;
 
-		initH += destJ[nType] * (nSuper != destSuper);
-		postH += sourceJ[nType] * (nSuper != sourceSuper);
+	for (int n = 0; n < 8; n++) {
+		initH += destJ[nType[n]] * (nSuper[n] != destSuper);
+		postH += sourceJ[nType[n]] * (nSuper[n] != sourceSuper);
 	}
 
 	return (postH - initH);
 }
 
 double SquareCellGrid::getVolumeDelta(int sourceX, int sourceY, int destX, int destY) {
+	return getVolumeDeltaAt(lattice[index(sourceX, sourceY)], lattice[index(destX, destY)]);
+}
+
+/**
+ * @brief Change in volume energy if one site moves from destSuper to sourceSuper
+ *
+ * @param sourceSuper SuperCell gaining a site
+ * @param destSuper SuperCell losing a site
+ * @return double
+ */
+double SquareCellGrid::getVolumeDeltaAt(int sourceSuper, int destSuper) const {
+	return volumeDeltaKernel(sourceSuper, destSuper, SuperCell::getVolume(sourceSuper), SuperCell::getVolume(destSuper));
+}
+
+/**
+ * @brief Volume energy change for the given current volumes of the two SuperCells
+ */
+double SquareCellGrid::volumeDeltaKernel(int sourceSuper, int destSuper, int sourceVol, int destVol) const {
+	return (double)volumeDeltaSites(sourceSuper, destSuper, sourceVol, destVol);
+}
 
-	int destSuper = internalGrid[destX][destY];
+/**
+ * @brief Volume energy change before LAMBDA, which is always a whole number. Uses the closed
+ * forms (v + 1 - t)^2 - (v - t)^2 = 2(v - t) + 1 and (v - 1 - t)^2 - (v - t)^2 = 1 - 2(v - t).
+ */
+int SquareCellGrid::volumeDeltaSites(int sourceSuper, int destSuper, int sourceVol, int destVol) const {
 
 	// Prevent destruction of cells
-	if (SuperCell::getVolume(destSuper) - 1 == 0)
-		return 1000000.0f;
+	if (destVol - 1 == 0)
+		return 1000000;
 
-	int sourceSuper = internalGrid[sourceX][sourceY];
+	// Prevent medium volume from affecting energy
+	const int sourceTerm = SuperCell::ignoreVolume(sourceSuper) ? 0 : 2 * (sourceVol - SuperCell::getTargetVolume(sourceSuper)) + 1;
+	const int destTerm = SuperCell::ignoreVolume(destSuper) ? 0 : 1 - 2 * (destVol - SuperCell::getTargetVolume(destSuper));
 
-	int sourceVol = SuperCell::getVolume(sourceSuper);
-	int destVol = SuperCell::getVolume(destSuper);
+	return sourceTerm + destTerm;
+}
 
-	int sourceTarget = SuperCell::getTargetVolume(sourceSuper);
-	int destTarget = SuperCell::getTargetVolume(destSuper);
+/**
+ * @brief Switch the Hamiltonian between floating point and fixed point. The fixed-point scale is
+ * the smallest power of two, up to 256, that makes every J * OMEGA and LAMBDA whole; energies are
+ * rounded to 1/256 if none does. Acceptance probabilities exp(-deltaH / BOLTZ_TEMP) are tabulated
+ * as 32 bit thresholds up to the energy where they fall below 2^-32.
+ *
+ * Call after CellType::buildJTable and after BOLTZ_TEMP, OMEGA and LAMBDA are set.
+ *
+ * @param on
+ */
+void SquareCellGrid::setIntegerEnergy(bool on) {
 
-	double deltaH = 0.0f;
+	integerEnergy = on;
 
-	// Prevent medium volume from affecting energy
-	bool sourceIgnore = SuperCell::ignoreVolume(sourceSuper);
-	bool destIgnore = SuperCell::ignoreVolume(destSuper);
+	if (!on)
+		return;
+
+	const double *J = CellType::getJTable();
+	const int entries = CellType::getJTableSize();
+
+	auto isWhole = [](double v) {
+		return std::abs(v - std::round(v)) < 1e-9;
+	};
+
+	bool whole = false;
 
-	deltaH = (!sourceIgnore) * ((double)pow(sourceVol + 1 - sourceTarget, 2) - (double)pow(sourceVol - sourceTarget, 2)) + (!destIgnore) * ((double)pow(destVol - 1 - destTarget, 2) - (double)pow(destVol - destTarget, 2));
+	for (energyScale = 1; energyScale <= 256 && !whole; energyScale *= 2) {
 
-	return deltaH;
+		whole = isWhole(LAMBDA * energyScale);
+		for (int k = 0; k < entries && whole; k++) {
+			whole = isWhole(J[k] * OMEGA * energyScale);
+		}
+	}
+	energyScale /= 2;
+
+	if (!whole)
+		std::cout << "J * OMEGA and LAMBDA are not multiples of 1/256, integer energies are rounded" << std::endl;
+
+	jFixed.resize(entries);
+	for (int k = 0; k < entries; k++) {
+		jFixed[k] = std::llround(J[k] * OMEGA * energyScale);
+	}
+	lambdaFixed = std::llround(LAMBDA * energyScale);
+
+	// Beyond this the acceptance probability is below 2^-32
+	const double kT = BOLTZ_TEMP * energyScale;
+	const std::int64_t cutoff = (kT > 0) ? (std::int64_t)std::ceil(kT * 32.0 * std::log(2.0)) + 1 : 0;
+
+	acceptThreshold.resize(cutoff);
+	for (std::int64_t dH = 0; dH < cutoff; dH++) {
+		const double threshold = std::ceil(std::exp(-dH / kT) * 0x1.0p32);
+		acceptThreshold[dH] = (threshold >= 0x1.0p32) ? 0xFFFFFFFFu : (std::uint32_t)threshold;
+	}
+
+	std::cout << "Integer energies, scale 1/" << energyScale << ", " << cutoff << " acceptance thresholds" << std::endl;
+}
+
+/**
+ * @brief Colour every site of a lattice, frame included, row by row through a palette of packed
+ * pixels
+ *
+ * @param sites Lattice in the layout of this grid
+ * @param palette Packed RGBA pixel of each SuperCell
+ * @param out boundaryWidth * boundaryHeight RGBA pixels
+ */
+void SquareCellGrid::colourSites(const int *sites, const std::uint32_t *palette, uint8_t *out) const {
+
+	for (int y = 0; y < boundaryHeight; y++) {
+
+		const int *row = sites + index(0, y);
+		uint8_t *dst = out + (std::size_t)boundaryWidth * 4 * y;
+
+		for (int x = 0; x < boundaryWidth; x++) {
+			std::memcpy(dst + 4 * x, &palette[row[x]], 4);
+		}
+	}
 }
 
 void SquareCellGrid::fullTextureRefresh() {
+	colourSites(lattice.data(), SuperCell::getPalette(), pixels.data());
+}
+
+/**
+ * @brief Bring a frame up to date with the lattice and the SuperCell palette, copying only the
+ * spans that changed since the frame was last captured. Cells whose colour changed since the
+ * last capture of any frame have their spans stamped first. Buffers are reused, so once a frame
+ * has grown to size capturing into it only allocates when the number of SuperCells grows.
+ *
+ * @param F Frame to bring up to date
+ */
+void SquareCellGrid::captureFrame(LatticeFrame &F) {
+
+	const std::uint32_t *palette = SuperCell::getPalette();
+	const int numSupers = SuperCell::getNumSupers();
+
+	for (int c = 0; c < (int)capturedPalette.size() && c < numSupers; c++) {
+
+		if (capturedPalette[c] == palette[c])
+			continue;
+
+		for (int i = firstCellSite(c); i != -1; i = nextCellSite(i)) {
+			spanEpoch[i / SPAN] = frameEpoch;
+		}
+	}
+
+	capturedPalette.assign(palette, palette + numSupers);
+
+	if (F.lattice.size() != lattice.size()) {
+
+		F.lattice.assign(lattice.begin(), lattice.end());
+		F.spanEpoch = spanEpoch;
+
+	} else {
+
+		for (int k = 0; k < (int)spanEpoch.size(); k++) {
+
+			if (spanEpoch[k] <= F.epoch)
+				continue;
+
+			std::copy_n(lattice.begin() + k * SPAN, SPAN, F.lattice.begin() + k * SPAN);
+			F.spanEpoch[k] = spanEpoch[k];
+		}
+	}
 
-	for (int x = 0; x < boundaryWidth; x++) {
+	F.palette.assign(palette, palette + numSupers);
+	F.epoch = frameEpoch++;
+}
+
+/**
+ * @brief Recolour the spans of a captured frame that changed after an earlier capture. Only
+ * reads the dimensions of the grid, so it is safe to call while another thread runs the
+ * simulation.
+ *
+ * @param F Captured frame
+ * @param out boundaryWidth * boundaryHeight RGBA pixels, holding the frame of epoch since
+ * @param since Epoch of the frame out holds, 0 to colour everything
+ * @param rows Receives the (first row, row count) ranges that were recoloured
+ */
+void SquareCellGrid::colourFrame(const LatticeFrame &F, uint8_t *out, std::uint32_t since, std::vector<std::pair<int, int>> &rows) const {
 
-		for (int y = 0; y < boundaryHeight; y++) {
+	rows.clear();
 
-			const unsigned int pixOffset = (boundaryWidth * 4 * y) + x * 4;
-			std::vector<int> colourIn = SuperCell::getColour(internalGrid[x][y]);
+	const int spansPerRow = rowStride / SPAN;
+
+	for (int y = 0; y < boundaryHeight; y++) {
 
-			if (colourIn.size() == 0) {
-				colourIn = {0, 0, 0, 0};
+		bool changed = false;
+
+		for (int s = 0; s < spansPerRow && s * SPAN < boundaryWidth; s++) {
+
+			const int k = y * spansPerRow + s;
+
+			if (F.spanEpoch[k] <= since)
+				continue;
+
+			const int *row = F.lattice.data() + k * SPAN;
+			uint8_t *dst = out + ((std::size_t)boundaryWidth * y + s * SPAN) * 4;
+
+			for (int x = 0; x < SPAN && s * SPAN + x < boundaryWidth; x++) {
+				std::memcpy(dst + 4 * x, &F.palette[row[x]], 4);
 			}
 
-			pixels[pixOffset + 0] = (uint8_t)colourIn[0];
-			pixels[pixOffset + 1] = (uint8_t)colourIn[1];
-			pixels[pixOffset + 2] = (uint8_t)colourIn[2];
-			pixels[pixOffset + 3] = (uint8_t)255;
+			changed = true;
+		}
+
+		if (!changed)
+			continue;
+
+		if (!rows.empty() && rows.back().first + rows.back().second == y) {
+			rows.back().second++;
+		} else {
+			rows.push_back({y, 1});
 		}
 	}
 }
 
-std::vector<uint8_t> SquareCellGrid::getPixels() {
+/**
+ * @brief Write a captured frame as a PNG, straight from its cell IDs. When the cells on the
+ * lattice have at most 256 distinct colours each cell is mapped to a palette index, otherwise
+ * rows are coloured as RGB. Like colourFrame, safe to call while the simulation runs.
+ *
+ * @param out Stream to write to
+ * @param F Captured frame
+ * @param threads Threads compressing the image
+ */
+void SquareCellGrid::writeFramePng(std::ostream &out, const LatticeFrame &F, unsigned int threads) const {
+
+	// Palette index of each cell on the lattice, -1 for cells not seen yet
+	std::vector<std::int16_t> cellIndex(F.palette.size(), -1);
+	std::vector<std::uint32_t> colours;
+
+	for (int y = 0; y < boundaryHeight && (int)colours.size() <= PngWriter::MAX_PALETTE; y++) {
+
+		const int *row = F.lattice.data() + index(0, y);
+
+		for (int x = 0; x < boundaryWidth; x++) {
+
+			const int c = row[x];
+
+			if (cellIndex[c] != -1)
+				continue;
+
+			auto it = std::find(colours.begin(), colours.end(), F.palette[c]);
+			cellIndex[c] = (std::int16_t)(it - colours.begin());
+
+			if (it == colours.end())
+				colours.push_back(F.palette[c]);
+		}
+	}
+
+	if ((int)colours.size() > PngWriter::MAX_PALETTE) {
+
+		PngWriter::writeRGB(out, boundaryWidth, boundaryHeight, [&](int y, uint8_t *row) {
+			const int *sites = F.lattice.data() + index(0, y);
+			for (int x = 0; x < boundaryWidth; x++) {
+				std::memcpy(row + 3 * x, &F.palette[sites[x]], 3);
+			}
+		}, threads);
+
+		return;
+	}
+
+	std::vector<uint8_t> palette(colours.size() * 3);
+	for (std::size_t p = 0; p < colours.size(); p++) {
+		std::memcpy(&palette[3 * p], &colours[p], 3);
+	}
+
+	PngWriter::writeIndexed(out, boundaryWidth, boundaryHeight, palette, [&](int y, uint8_t *row) {
+		const int *sites = F.lattice.data() + index(0, y);
+		for (int x = 0; x < boundaryWidth; x++) {
+			row[x] = (uint8_t)cellIndex[sites[x]];
+		}
+	}, threads);
+}
 
+/**
+ * @brief Pixels coloured by the last fullTextureRefresh, without copying them
+ */
+std::span<const uint8_t> SquareCellGrid::getPixels() const {
 	return pixels;
 }
@@ -1,28 +1,49 @@
 #include "headers/SuperCell.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
 #include "headers/ColourScheme.h"
 #include "headers/RandomNumberGenerators.h"
 
-static std::vector<SuperCell> superCells = std::vector<SuperCell>();
+/**
+ * @brief Pack the per-cell flag bits of a cell type
+ *
+ * @param t ID of cell type
+ * @return uint8_t
+ */
+uint8_t SuperCell::typeFlags(int t) {
+
+	CellType &T = CellType::getType(t);
+
+	return (T.isStatic ? FLAG_STATIC : 0) |
+		   (T.ignoreVolume ? FLAG_IGNORE_VOLUME : 0) |
+		   (T.doesDivide ? FLAG_DIVIDE : 0) |
+		   (T.countable ? FLAG_COUNTABLE : 0);
+}
 
 /**
- * @brief Construct a new SuperCell object. Should only be used by "makeNewSuperCell"
+ * @brief Reserve room for a number of SuperCells, so that creating them never reallocates the table
  *
- * @param type ID of cell type
- * @param generation Generation of new SuperCell
- * @param targetVolume Target Volume
- * @param targetSurface Target Surface
+ * @param capacity Expected number of SuperCells over the whole run
  */
-SuperCell::SuperCell(int type, int generation, int targetVolume) {
+void SuperCell::reserve(int capacity) {
 
-	this->ID = superCells.size();
-	this->cellType = type;
-	this->generation = generation;
-	this->targetVolume = targetVolume;
+	table.type.reserve(capacity);
+	table.volume.reserve(capacity);
+	table.targetVolume.reserve(capacity);
+	table.dead.reserve(capacity);
+	table.flags.reserve(capacity);
+
+	table.ID.reserve(capacity);
+	table.generation.reserve(capacity);
+	table.lastDivMCS.reserve(capacity);
+	table.nextDivMCS.reserve(capacity);
+	table.colour.reserve(capacity);
+	table.pixel.reserve(capacity);
+	table.memberSlot.reserve(capacity);
 }
 
 /**
@@ -31,19 +52,60 @@ SuperCell::SuperCell(int type, int generation, int targetVolume) {
  * @param type ID of cell type
  * @param gen generation of cell to create
  * @param targetV Target volume of new cell
- * @param targetSurface Target surface of new cell
  * @return int ID of the newly created SuperCell
  */
 int SuperCell::makeNewSuperCell(int type, int gen, int targetV) {
 
-	SuperCell sc = SuperCell(type, gen, targetV);
-	superCells.push_back(sc);
+	if (!freeSlots.empty()) {
+
+		const int c = freeSlots.back();
+		freeSlots.pop_back();
+
+		table.type[c] = type;
+		table.volume[c] = 0;
+		table.targetVolume[c] = targetV;
+		table.dead[c] = false;
+		table.flags[c] = typeFlags(type);
+
+		table.ID[c] = nextID++;
+		table.generation[c] = gen;
+		table.lastDivMCS[c] = SimClock::now();
+		table.nextDivMCS[c] = 9999999;
+		table.colour[c] = {255, 255, 255, 255};
+		table.pixel[c] = packPixel(table.colour[c]);
+
+		addMember(c, type);
+		liveByType[type]++;
+
+		rescheduled.push_back(c);
+		revision++;
+
+		return c;
+	}
+
+	int id = (int)table.type.size();
+
+	table.type.push_back(type);
+	table.volume.push_back(0);
+	table.targetVolume.push_back(targetV);
+	table.dead.push_back(false);
+	table.flags.push_back(typeFlags(type));
+
+	table.ID.push_back(nextID++);
+	table.generation.push_back(gen);
+	table.lastDivMCS.push_back(SimClock::now());
+	table.nextDivMCS.push_back(9999999);
+	table.colour.push_back({255, 255, 255, 255});
+	table.pixel.push_back(packPixel(table.colour.back()));
 
-	std::sort(superCells.begin(), superCells.end(), [](const SuperCell &lhs, const SuperCell &rhs) {
-		return lhs.ID < rhs.ID;
-	});
+	table.memberSlot.push_back(-1);
+	addMember(id, type);
+	liveByType[type]++;
 
-	return superCells.size() - 1;
+	rescheduled.push_back(id);
+	revision++;
+
+	return id;
 }
 
 /**
@@ -66,149 +128,394 @@ int SuperCell::makeNewSuperCell(SuperCellTemplate &T) {
 	return SuperCell::makeNewSuperCell(T.type, 0, T.volume);
 }
 
+/**
+ * @brief External ID of a SuperCell, for logs and lineage. Unlike the index into the table, it is
+ * never reused, and it does not change when the table is compacted.
+ *
+ * @param i Index of SuperCell
+ * @return int
+ */
 int SuperCell::getID(int i) {
-	return superCells[i].ID;
-}
-
-bool SuperCell::isStatic(int c) {
-	return CellType::getType(superCells[c].cellType).isStatic;
-}
-
-bool SuperCell::doDivide(int c) {
-	return CellType::getType(superCells[c].cellType).doesDivide;
-}
-
-bool SuperCell::ignoreVolume(int c) {
-	return CellType::getType(superCells[c].cellType).ignoreVolume;
+	return table.ID[i];
 }
 
 double SuperCell::getDivMean(int c) {
-	return CellType::getType(superCells[c].cellType).divideMean;
+	return CellType::getType(table.type[c]).divideMean;
 }
 
 double SuperCell::getDivSD(int c) {
-	return CellType::getType(superCells[c].cellType).divideSD;
+	return CellType::getType(table.type[c]).divideSD;
 }
 
 int SuperCell::getDivType(int c) {
-	return CellType::getType(superCells[c].cellType).divideType;
+	return CellType::getType(table.type[c]).divideType;
 }
 
 int SuperCell::getDivMinVol(int c) {
-	return CellType::getType(superCells[c].cellType).divMinVolume;
+	return CellType::getType(table.type[c]).divMinVolume;
 }
 
 int SuperCell::getDivMinRatio(int c) {
-	return CellType::getType(superCells[c].cellType).divMinRatio;
+	return CellType::getType(table.type[c]).divMinRatio;
 }
 
 int SuperCell::getGeneration(int i) {
-	return superCells[i].generation;
+	return table.generation[i];
 }
 
 void SuperCell::increaseGeneration(int i) {
-	superCells[i].generation++;
+	table.generation[i]++;
 }
 
 void SuperCell::setGeneration(int i, int gen) {
-	superCells[i].generation = gen;
+	table.generation[i] = gen;
 }
 
+/**
+ * @brief MCS since the cell last divided, or since its age was last set
+ *
+ * @param c ID of SuperCell
+ * @return int
+ */
 int SuperCell::getMCS(int c) {
-	return superCells[c].lastDivMCS;
+	return SimClock::now() - table.lastDivMCS[c];
 }
 
 void SuperCell::setMCS(int c, int i) {
-	superCells[c].lastDivMCS = i;
-}
-
-void SuperCell::increaseMCS() {
-	for (int x = 0; x < superCells.size(); x++) {
-		superCells[x].lastDivMCS++;
-	}
+	table.lastDivMCS[c] = SimClock::now() - i;
+	rescheduled.push_back(c);
 }
 
 int SuperCell::getNextDiv(int c) {
-	return superCells[c].nextDivMCS;
+	return table.nextDivMCS[c];
 }
 
 void SuperCell::setNextDiv(int c, int i) {
-	superCells[c].nextDivMCS = i;
+	table.nextDivMCS[c] = i;
+	rescheduled.push_back(c);
 }
 
-int SuperCell::getTargetVolume(int c) {
-	return superCells[c].targetVolume;
+/**
+ * @brief Hand over the cells whose division time, type or death state changed, and clear the list
+ *
+ * @param out Receives the cells, possibly more than once each
+ */
+void SuperCell::takeRescheduled(std::vector<int> &out) {
+	out.clear();
+	out.swap(rescheduled);
 }
 
 void SuperCell::setTargetVolume(int i, int target) {
 
-	superCells[i].targetVolume = target;
-}
-
-int SuperCell::getCellType(int c) {
-	return superCells[c].cellType;
+	table.targetVolume[i] = target;
+	revision++;
 }
 
 void SuperCell::setCellType(int c, int t) {
-	superCells[c].cellType = t;
-}
 
-std::vector<double> &SuperCell::getJ(int c) {
-	return CellType::getType(superCells[c].cellType).J;
+	if (!(table.flags[c] & FLAG_FREE)) {
+
+		removeMember(c, table.type[c]);
+		addMember(c, t);
+
+		std::vector<int> &counts = table.dead[c] ? deadByType : liveByType;
+		counts[table.type[c]]--;
+		counts[t]++;
+	}
+
+	table.type[c] = t;
+	table.flags[c] = typeFlags(t);
+	rescheduled.push_back(c);
+	revision++;
 }
 
-int SuperCell::getNumSupers() {
-	return superCells.size();
+std::vector<double> &SuperCell::getJ(int c) {
+	return CellType::getType(table.type[c]).J;
 }
 
 int SuperCell::getColourScheme(int c) {
-	return CellType::getType(superCells[c].cellType).colourScheme;
+	return CellType::getType(table.type[c]).colourScheme;
 }
 
 void SuperCell::setColour(int i, int r, int g, int b, int a) {
-	SuperCell &C = superCells[i];
-	C.colour[0] = b;
-	C.colour[1] = g;
-	C.colour[2] = r;
-	C.colour[3] = a;
+	table.colour[i] = {b, g, r, a};
+	table.pixel[i] = packPixel(table.colour[i]);
 }
 
 void SuperCell::setColour(int i, std::vector<int> col) {
-	superCells[i].colour = col;
+	std::copy_n(col.begin(), std::min<size_t>(col.size(), 4), table.colour[i].begin());
+	table.pixel[i] = packPixel(table.colour[i]);
+}
+
+/**
+ * @brief Pack the first three channels of a colour into the bytes of a pixel, in memory order,
+ * with an opaque alpha
+ */
+std::uint32_t SuperCell::packPixel(const std::array<int, 4> &colour) {
+
+	const uint8_t bytes[4] = {(uint8_t)colour[0], (uint8_t)colour[1], (uint8_t)colour[2], 255};
+
+	std::uint32_t pixel;
+	std::memcpy(&pixel, bytes, 4);
+
+	return pixel;
 }
 
 std::vector<int> SuperCell::getColour(int i) {
-	return superCells[i].colour;
+	return std::vector<int>(table.colour[i].begin(), table.colour[i].end());
 }
 
 void SuperCell::generateNewColour(int c) {
 
-	setColour(c, ColourScheme::generateColour(getColourScheme(c)));
+	setColour(c, ColourScheme::generateColour(getColourScheme(c), getID(c)));
 }
 
 int SuperCell::generateNewDivisionTime(int c) {
-	return (int)RandomNumberGenerators::rNormalDouble(SuperCell::getDivMean(c), SuperCell::getDivSD(c));
+	return (int)RandomNumberGenerators::rNormalDouble(SuperCell::getDivMean(c), SuperCell::getDivSD(c), getID(c), RandomNumberGenerators::DIVISION_TIME);
 }
 
-void SuperCell::changeVolume(int i, int delta) {
-	superCells[i].volume += delta;
+void SuperCell::setVolume(int i, int v) {
+	table.volume[i] = v;
+	revision++;
 }
 
-void SuperCell::setVolume(int i, int v) {
-	superCells[i].volume = v;
+void SuperCell::setDead(int c, bool d) {
+
+	if (d && !table.dead[c])
+		dying.push_back(c);
+
+	if (!d && table.dead[c])
+		rescheduled.push_back(c);
+
+	if (d != (bool)table.dead[c] && !(table.flags[c] & FLAG_FREE)) {
+		liveByType[table.type[c]] += d ? -1 : 1;
+		deadByType[table.type[c]] += d ? 1 : -1;
+	}
+
+	table.dead[c] = d;
+	revision++;
+}
+
+/**
+ * @brief Free the slots of dead cells that have lost all their sites, so that new cells reuse them
+ * and the table stops growing with every death
+ *
+ * @return int Number of cells retired
+ */
+int SuperCell::retireDead() {
+
+	int retired = 0;
+
+	for (size_t k = 0; k < dying.size();) {
+
+		const int c = dying[k];
+
+		// Still holding sites
+		if (table.dead[c] && table.volume[c] > 0) {
+			k++;
+			continue;
+		}
+
+		dying[k] = dying.back();
+		dying.pop_back();
+
+		// Revived, or killed again after being revived and already retired
+		if (!table.dead[c] || (table.flags[c] & FLAG_FREE))
+			continue;
+
+		if (table.type[c] >= (int)retiredByType.size())
+			retiredByType.resize(table.type[c] + 1, 0);
+		retiredByType[table.type[c]]++;
+
+		removeMember(c, table.type[c]);
+		deadByType[table.type[c]]--;
+
+		table.flags[c] = FLAG_FREE;
+		freeSlots.push_back(c);
+		retired++;
+	}
+
+	return retired;
+}
+
+/**
+ * @brief Number of dead cells of a type that have been retired
+ *
+ * @param type ID of cell type, or -1 for all types
+ * @return int
+ */
+int SuperCell::getRetiredDead(int type) {
+
+	if (type == -1) {
+
+		int count = 0;
+		for (int n : retiredByType) {
+			count += n;
+		}
+
+		return count;
+	}
+
+	return (type >= 0 && type < (int)retiredByType.size()) ? retiredByType[type] : 0;
 }
 
-int SuperCell::getVolume(int i) {
-	return superCells[i].volume;
+/**
+ * @brief Add a cell to the member list of a type
+ */
+void SuperCell::addMember(int c, int t) {
+
+	if (t >= (int)typeMembers.size()) {
+		typeMembers.resize(t + 1);
+		liveByType.resize(t + 1, 0);
+		deadByType.resize(t + 1, 0);
+	}
+
+	table.memberSlot[c] = (int)typeMembers[t].size();
+	typeMembers[t].push_back(c);
 }
 
-bool SuperCell::isCountable(int c) {
-	return CellType::getType(superCells[c].cellType).countable;
+/**
+ * @brief Remove a cell from the member list of a type, in O(1) by moving the last member into its place
+ */
+void SuperCell::removeMember(int c, int t) {
+
+	std::vector<int> &members = typeMembers[t];
+
+	const int slot = table.memberSlot[c];
+	const int last = members.back();
+
+	members[slot] = last;
+	table.memberSlot[last] = slot;
+	members.pop_back();
+
+	table.memberSlot[c] = -1;
 }
 
- bool SuperCell::isDead(int c) {
-	return superCells[c].dead;
+/**
+ * @brief Members of a type in ID order, the order a scan over all cells would visit them in.
+ * A copy, so the caller may change cell types while walking it.
+ *
+ * @param t ID of cell type
+ * @param out Receives the members
+ */
+void SuperCell::getTypeMembersSorted(int t, std::vector<int> &out) {
+
+	const std::vector<int> &members = getTypeMembers(t);
+
+	out.assign(members.begin(), members.end());
+	std::sort(out.begin(), out.end());
 }
- void SuperCell::setDead(int c, bool d) {
-	superCells[c].dead = d;
- }
\ No newline at end of file
+
+/**
+ * @brief Number of dead cells of a type, retired or not
+ *
+ * @param t ID of cell type, or -1 for all types
+ * @return int
+ */
+int SuperCell::getDeadCount(int t) {
+
+	if (t == -1) {
+
+		int count = 0;
+		for (int n : deadByType) {
+			count += n;
+		}
+
+		return count + getRetiredDead(-1);
+	}
+
+	return ((t >= 0 && t < (int)deadByType.size()) ? deadByType[t] : 0) + getRetiredDead(t);
+}
+
+/**
+ * @brief Number of live cells of countable types
+ */
+int SuperCell::getLiveCountable() {
+
+	int count = 0;
+
+	for (int t = 0; t < (int)liveByType.size(); t++) {
+		if (liveByType[t] != 0 && (typeFlags(t) & FLAG_COUNTABLE))
+			count += liveByType[t];
+	}
+
+	return count;
+}
+
+/**
+ * @brief Remove free slots from the table, moving the remaining cells down in order. Anything
+ * indexed by SuperCell must be remapped by the caller, the lattice included.
+ *
+ * @return std::vector<int> New index of each old index, -1 for removed slots
+ */
+std::vector<int> SuperCell::compact() {
+
+	const int n = getNumSupers();
+	std::vector<int> remap(n, -1);
+
+	int next = 0;
+
+	for (int c = 0; c < n; c++) {
+
+		if (table.flags[c] & FLAG_FREE)
+			continue;
+
+		remap[c] = next;
+
+		if (next != c) {
+			table.type[next] = table.type[c];
+			table.volume[next] = table.volume[c];
+			table.targetVolume[next] = table.targetVolume[c];
+			table.dead[next] = table.dead[c];
+			table.flags[next] = table.flags[c];
+
+			table.ID[next] = table.ID[c];
+			table.generation[next] = table.generation[c];
+			table.lastDivMCS[next] = table.lastDivMCS[c];
+			table.nextDivMCS[next] = table.nextDivMCS[c];
+			table.colour[next] = table.colour[c];
+			table.pixel[next] = table.pixel[c];
+		}
+
+		next++;
+	}
+
+	table.type.resize(next);
+	table.volume.resize(next);
+	table.targetVolume.resize(next);
+	table.dead.resize(next);
+	table.flags.resize(next);
+
+	table.ID.resize(next);
+	table.generation.resize(next);
+	table.lastDivMCS.resize(next);
+	table.nextDivMCS.resize(next);
+	table.colour.resize(next);
+	table.pixel.resize(next);
+
+	freeSlots.clear();
+
+	// Member lists hold old indices, so rebuild them in ID order
+	table.memberSlot.assign(next, -1);
+	for (std::vector<int> &members : typeMembers) {
+		members.clear();
+	}
+	for (int c = 0; c < next; c++) {
+		addMember(c, table.type[c]);
+	}
+
+	for (int &c : dying) {
+		c = remap[c];
+	}
+
+	// Anything scheduled by the old indices is stale
+	rescheduled.clear();
+	for (int c = 0; c < next; c++) {
+		rescheduled.push_back(c);
+	}
+
+	revision++;
+	compactions++;
+
+	return remap;
+}
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "./headers/SweepHandler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "./headers/RandomNumberGenerators.h"
+#include "./headers/RejectionFreeSweep.h"
+
+static std::shared_ptr<SquareCellGrid> grid;
+
+static unsigned int numThreads = 1;
+static unsigned int sweepMode = SweepHandler::RANDOM_SITE;
+static bool tiled = false;
+
+// Serial sweeps draw proposal coordinates in batches
+static const unsigned int BATCH_SIZE = 4096;
+static std::vector<int> batchX;
+static std::vector<int> batchY;
+
+// Parallel sweeps split the interior into square tiles coloured as a 2x2 checkerboard. Tiles of
+// one colour are a whole tile apart, so as long as a tile is at least 3 sites wide no copy made
+// in one can change any site read by a proposal in another.
+static const int TILE_SIZE = 32;
+
+struct Tile {
+	int id;
+	int x0;
+	int y0;
+	int w;
+	int h;
+};
+
+static std::vector<Tile> tilesByColour[4];
+static std::vector<SquareCellGrid::TileJournal> journals;
+
+static std::vector<std::thread> workers;
+static std::unique_ptr<std::barrier<>> phaseStart;
+static std::unique_ptr<std::barrier<>> phaseEnd;
+static std::atomic<unsigned int> nextTile(0);
+static std::atomic<bool> stopping(false);
+static int activeColour = 0;
+
+static void sweepTile(const Tile &T) {
+
+	SquareCellGrid::TileJournal &J = journals[T.id];
+	const int proposals = T.w * T.h;
+
+	if (RandomNumberGenerators::isCounterMode()) {
+
+		// Keyed by tile and proposal, so the result does not depend on which thread runs the tile
+		const unsigned int base = T.id * TILE_SIZE * TILE_SIZE;
+
+		for (int k = 0; k < proposals; k++) {
+
+			auto R = RandomNumberGenerators::counterBlock(base + k, RandomNumberGenerators::PROPOSAL);
+
+			grid->moveCellInTile(T.x0 + RandomNumberGenerators::wordToInt(R[0], 0, T.w - 1),
+								 T.y0 + RandomNumberGenerators::wordToInt(R[1], 0, T.h - 1),
+								 RandomNumberGenerators::wordToInt(R[2], 0, 7),
+								 RandomNumberGenerators::wordToProb(R[3]), J);
+		}
+
+	} else {
+
+		for (int k = 0; k < proposals; k++) {
+			grid->moveCellInTile(T.x0 + RandomNumberGenerators::rUnifInt(0, T.w - 1),
+								 T.y0 + RandomNumberGenerators::rUnifInt(0, T.h - 1), J);
+		}
+	}
+}
+
+/**
+ * @brief One MCS of proposals drawn from boundary sites only. A uniformly chosen site is a
+ * boundary site with probability p = boundary / interior, and every other proposal is a no-op,
+ * so each boundary proposal stands in for a geometrically distributed number of uniform ones.
+ * Proposals are made until those add up to one MCS.
+ */
+static void boundarySweep() {
+
+	const double iMCS = (double)grid->interiorWidth * grid->interiorHeight;
+	double consumed = 0.0;
+
+	for (unsigned int k = 0;; k++) {
+
+		const int boundary = grid->getNumBoundarySites();
+
+		if (boundary == 0)
+			return;
+
+		double skip;
+		int site;
+		int neighbour;
+		double accept;
+
+		if (RandomNumberGenerators::isCounterMode()) {
+
+			auto R = RandomNumberGenerators::counterBlock(k, RandomNumberGenerators::PROPOSAL);
+
+			skip = RandomNumberGenerators::wordToProb(R[0]) + 0x1.0p-32;
+			site = RandomNumberGenerators::wordToInt(R[1], 0, boundary - 1);
+			neighbour = RandomNumberGenerators::wordToInt(R[2], 0, 7);
+			accept = RandomNumberGenerators::wordToProb(R[3]);
+
+		} else {
+
+			skip = 1.0 - RandomNumberGenerators::rUnifProb();
+			site = RandomNumberGenerators::rUnifInt(0, boundary - 1);
+			neighbour = RandomNumberGenerators::rUnifInt(0, 7);
+			accept = RandomNumberGenerators::rUnifProb();
+		}
+
+		// Uniform proposals up to and including the one that lands on a boundary site
+		const double p = boundary / iMCS;
+		consumed += (p < 1.0) ? std::floor(std::log(skip) / std::log1p(-p)) + 1.0 : 1.0;
+
+		if (consumed > iMCS)
+			return;
+
+		grid->moveCellAt(grid->getBoundarySite(site), neighbour, accept);
+	}
+}
+
+static void processTiles() {
+
+	const std::vector<Tile> &tiles = tilesByColour[activeColour];
+
+	for (unsigned int t = nextTile++; t < tiles.size(); t = nextTile++) {
+		sweepTile(tiles[t]);
+	}
+}
+
+static void workerLoop(unsigned int w) {
+
+	RandomNumberGenerators::setThreadStream(2 + w);
+
+	while (true) {
+
+		phaseStart->arrive_and_wait();
+
+		if (stopping)
+			return;
+
+		processTiles();
+
+		phaseEnd->arrive_and_wait();
+	}
+}
+
+/**
+ * @brief Set up the Monte Carlo sweep. With more than one thread, or with counter-based draws,
+ * the sweep runs as a checkerboard of tiles processed concurrently.
+ *
+ * @param ptr Grid to sweep
+ * @param threads Number of threads, including the calling thread
+ * @param mode How source sites are chosen, see SweepHandler::Mode
+ */
+void SweepHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int threads, unsigned int mode) {
+
+	grid = ptr;
+	numThreads = std::max(1u, threads);
+	sweepMode = mode;
+
+	batchX.resize(BATCH_SIZE);
+	batchY.resize(BATCH_SIZE);
+
+	if (sweepMode == BOUNDARY_SITE || sweepMode == REJECTION_FREE) {
+
+		if (numThreads > 1)
+			std::cout << "Boundary site and rejection-free sweeps run on one thread" << std::endl;
+
+		if (sweepMode == REJECTION_FREE)
+			RejectionFreeSweep::initializeHandler(grid);
+
+		numThreads = 1;
+		return;
+	}
+
+	// Counter-based draws always sweep by tiles, so that results match for any thread count
+	tiled = (numThreads > 1) || RandomNumberGenerators::isCounterMode();
+
+	if (!tiled)
+		return;
+
+	const int tilesX = (grid->interiorWidth + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (grid->interiorHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; tx++) {
+
+			Tile T;
+			T.id = ty * tilesX + tx;
+			T.x0 = 1 + tx * TILE_SIZE;
+			T.y0 = 1 + ty * TILE_SIZE;
+			T.w = std::min(TILE_SIZE, grid->interiorWidth + 1 - T.x0);
+			T.h = std::min(TILE_SIZE, grid->interiorHeight + 1 - T.y0);
+
+			tilesByColour[(tx & 1) | ((ty & 1) << 1)].push_back(T);
+		}
+	}
+
+	journals.resize(tilesX * tilesY);
+
+	if (numThreads == 1)
+		return;
+
+	phaseStart = std::make_unique<std::barrier<>>(numThreads);
+	phaseEnd = std::make_unique<std::barrier<>>(numThreads);
+
+	for (unsigned int w = 0; w + 1 < numThreads; w++) {
+		workers.emplace_back(workerLoop, w);
+	}
+}
+
+/**
+ * @brief Run one Monte Carlo step, with as many proposals as there are interior sites
+ */
+void SweepHandler::runSweep() {
+
+	unsigned int iMCS = grid->interiorWidth * grid->interiorHeight;
+
+	if (sweepMode == BOUNDARY_SITE) {
+
+		boundarySweep();
+
+	} else if (sweepMode == REJECTION_FREE) {
+
+		RejectionFreeSweep::runSweep();
+
+	} else if (tiled) {
+
+		// Visit the four colours in a random order each MCS
+		int order[4] = {0, 1, 2, 3};
+		for (int k = 3; k > 0; k--) {
+			std::swap(order[k], order[RandomNumberGenerators::rUnifInt(0, k, k, RandomNumberGenerators::SWEEP_ORDER)]);
+		}
+
+		for (int colour : order) {
+
+			activeColour = colour;
+			nextTile = 0;
+
+			if (numThreads > 1) {
+				phaseStart->arrive_and_wait();
+				processTiles();
+				phaseEnd->arrive_and_wait();
+			} else {
+				processTiles();
+			}
+
+			// Apply volume changes and bookkeeping in tile order
+			for (const Tile &T : tilesByColour[colour]) {
+				grid->commitTile(journals[T.id]);
+			}
+		}
+
+	} else {
+
+		for (unsigned int i = 0; i < iMCS; i += BATCH_SIZE) {
+
+			unsigned int batch = std::min(BATCH_SIZE, iMCS - i);
+
+			RandomNumberGenerators::fillUnifInt(batchX.data(), batch, 1, grid->interiorWidth);
+			RandomNumberGenerators::fillUnifInt(batchY.data(), batch, 1, grid->interiorHeight);
+
+			for (unsigned int b = 0; b < batch; b++) {
+				grid->moveCell(batchX[b], batchY[b]);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Stop and join the worker threads
+ */
+void SweepHandler::shutdownHandler() {
+
+	if (workers.empty())
+		return;
+
+	stopping = true;
+	phaseStart->arrive_and_wait();
+
+	for (std::thread &T : workers) {
+		T.join();
+	}
+
+	workers.clear();
+}
@@ -0,0 +1,299 @@
+#include "./headers/TrajectoryHandler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "./headers/SuperCell.h"
+
+// Binary trajectory of the lattice, written to "run name".traj. Cells are identified by their
+// stable ID, so compaction of the SuperCell table does not show up as changes. All integers are
+// little-endian.
+//
+// Header:   "PTRJ", u32 version, u32 width, u32 height, u32 MCS between frames,
+//           u32 frames between keyframes
+// Frame:    u32 MCS, u8 kind (0 keyframe, 1 delta),
+//           u32 cell count, then per cell: i32 ID, i32 type, u8 dead, u8 red, green, blue
+//           u32 removed count, then per removed cell: i32 ID
+//           keyframe: width * height i32 IDs, row by row
+//           delta:    u32 change count, then per changed site: u32 y * width + x, i32 ID
+// Index:    u32 frame count, then per frame: u32 MCS, u8 kind, u64 file offset
+// Trailer:  u64 file offset of the index, "PIDX"
+//
+// A keyframe lists every cell, a delta only the cells that are new or whose type, death or colour
+// changed, and those that have gone. To read the lattice at some MCS, seek to the keyframe at or
+// before it through the index and apply the deltas that follow.
+
+static std::shared_ptr<SquareCellGrid> grid;
+
+static unsigned int trajectoryInterval = 0;
+static unsigned int keyframeInterval = 1;
+
+static std::ofstream out;
+
+struct IndexEntry {
+	std::uint32_t mcs;
+	std::uint8_t kind;
+	std::uint64_t offset;
+};
+
+static std::vector<IndexEntry> frameIndex;
+
+// Copy of the lattice kept by captureFrame, whose span epochs locate the sites to compare
+static SquareCellGrid::LatticeFrame frame;
+
+// ID at each lattice index as of the last frame written
+static std::vector<int> recordedLattice;
+
+// Cell properties as of the last frame written, indexed by ID
+struct CellRecord {
+	int type = -1;
+	std::uint32_t pixel = 0;
+	std::uint8_t dead = 0;
+	bool present = false;
+};
+
+static std::vector<CellRecord> recordedCells;
+static std::vector<int> recordedIDs;
+static std::vector<int> currentIDs;
+static std::vector<int> seenFrame;
+
+static std::vector<uint8_t> buffer;
+
+static void put8(std::uint8_t v) {
+	buffer.push_back(v);
+}
+
+static void put32(std::uint32_t v) {
+	for (int b = 0; b < 4; b++) {
+		buffer.push_back((uint8_t)(v >> (8 * b)));
+	}
+}
+
+static void put64(std::uint64_t v) {
+	for (int b = 0; b < 8; b++) {
+		buffer.push_back((uint8_t)(v >> (8 * b)));
+	}
+}
+
+static void flush() {
+	out.write((const char *)buffer.data(), buffer.size());
+	buffer.clear();
+}
+
+/**
+ * @brief Append the cells that changed since the last frame, or all of them for a keyframe
+ */
+static void putCells(bool keyframe) {
+
+	const int frameNumber = (int)frameIndex.size();
+	const std::uint32_t *palette = SuperCell::getPalette();
+
+	const std::size_t countAt = buffer.size();
+	put32(0);
+
+	std::uint32_t count = 0;
+	currentIDs.clear();
+
+	for (int c = 0; c < SuperCell::getNumSupers(); c++) {
+
+		if (SuperCell::isFree(c))
+			continue;
+
+		const int id = SuperCell::getID(c);
+
+		if (id >= (int)recordedCells.size()) {
+			recordedCells.resize(id + 1);
+			seenFrame.resize(id + 1, -1);
+		}
+
+		seenFrame[id] = frameNumber;
+		currentIDs.push_back(id);
+
+		CellRecord &R = recordedCells[id];
+		const CellRecord now = {SuperCell::getCellType(c), palette[c], (uint8_t)SuperCell::isDead(c), true};
+
+		if (!keyframe && R.present && R.type == now.type && R.pixel == now.pixel && R.dead == now.dead)
+			continue;
+
+		R = now;
+
+		const uint8_t *rgb = (const uint8_t *)&now.pixel;
+
+		put32((std::uint32_t)id);
+		put32((std::uint32_t)now.type);
+		put8(now.dead);
+		put8(rgb[0]);
+		put8(rgb[1]);
+		put8(rgb[2]);
+		count++;
+	}
+
+	for (int b = 0; b < 4; b++) {
+		buffer[countAt + b] = (uint8_t)(count >> (8 * b));
+	}
+
+	// Cells present last frame whose slots have since been retired
+	const std::size_t removedAt = buffer.size();
+	put32(0);
+
+	std::uint32_t removed = 0;
+
+	for (int id : recordedIDs) {
+
+		if (seenFrame[id] == frameNumber)
+			continue;
+
+		recordedCells[id].present = false;
+		put32((std::uint32_t)id);
+		removed++;
+	}
+
+	for (int b = 0; b < 4; b++) {
+		buffer[removedAt + b] = (uint8_t)(removed >> (8 * b));
+	}
+
+	recordedIDs.swap(currentIDs);
+}
+
+/**
+ * @brief Write one frame, capturing the lattice as it is now
+ */
+static void writeFrame(int mcs) {
+
+	const bool keyframe = frameIndex.size() % keyframeInterval == 0;
+	const std::uint32_t since = frame.epoch;
+
+	grid->captureFrame(frame);
+
+	frameIndex.push_back({(std::uint32_t)mcs, (std::uint8_t)(keyframe ? 0 : 1), (std::uint64_t)out.tellp()});
+
+	put32((std::uint32_t)mcs);
+	put8(keyframe ? 0 : 1);
+
+	putCells(keyframe);
+
+	const int width = grid->boundaryWidth;
+	const int stride = grid->rowStride;
+
+	if (recordedLattice.size() != frame.lattice.size())
+		recordedLattice.assign(frame.lattice.size(), -1);
+
+	if (keyframe) {
+
+		for (int y = 0; y < grid->boundaryHeight; y++) {
+			for (int x = 0; x < width; x++) {
+
+				const int i = y * stride + x;
+
+				recordedLattice[i] = SuperCell::getID(frame.lattice[i]);
+				put32((std::uint32_t)recordedLattice[i]);
+			}
+		}
+
+		flush();
+		return;
+	}
+
+	const std::size_t countAt = buffer.size();
+	put32(0);
+
+	std::uint32_t changes = 0;
+
+	// Only spans written since the last frame can hold changed sites
+	for (int k = 0; k < (int)frame.spanEpoch.size(); k++) {
+
+		if (frame.spanEpoch[k] <= since)
+			continue;
+
+		for (int i = k * SquareCellGrid::SPAN; i < (k + 1) * SquareCellGrid::SPAN; i++) {
+
+			const int x = i % stride;
+			if (x >= width)
+				break;
+
+			const int id = SuperCell::getID(frame.lattice[i]);
+			if (id == recordedLattice[i])
+				continue;
+
+			recordedLattice[i] = id;
+			put32((std::uint32_t)((i / stride) * width + x));
+			put32((std::uint32_t)id);
+			changes++;
+		}
+	}
+
+	for (int b = 0; b < 4; b++) {
+		buffer[countAt + b] = (uint8_t)(changes >> (8 * b));
+	}
+
+	flush();
+}
+
+/**
+ * @brief Set up the trajectory and write its first keyframe
+ *
+ * @param ptr Grid to record
+ * @param every MCS between frames, 0 for no trajectory
+ * @param keyframeEvery Frames between keyframes, the rest being deltas
+ * @param baseName Trajectory is written to baseName.traj
+ */
+void TrajectoryHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int every, unsigned int keyframeEvery, std::string baseName) {
+
+	grid = ptr;
+	trajectoryInterval = every;
+	keyframeInterval = std::max(1u, keyframeEvery);
+
+	if (trajectoryInterval == 0)
+		return;
+
+	out.open(baseName + ".traj", std::ios::binary);
+
+	buffer.insert(buffer.end(), {'P', 'T', 'R', 'J'});
+	put32(1);
+	put32((std::uint32_t)grid->boundaryWidth);
+	put32((std::uint32_t)grid->boundaryHeight);
+	put32(trajectoryInterval);
+	put32(keyframeInterval);
+	flush();
+
+	writeFrame(0);
+}
+
+/**
+ * @brief Write a frame if one is due at the end of this MCS
+ *
+ * @param m Current MCS
+ */
+void TrajectoryHandler::runTrajectoryLoop(int m) {
+
+	if (trajectoryInterval == 0 || (m + 1) % trajectoryInterval != 0)
+		return;
+
+	writeFrame(m + 1);
+}
+
+/**
+ * @brief Write the index of frames and close the trajectory
+ */
+void TrajectoryHandler::shutdownHandler() {
+
+	if (!out.is_open())
+		return;
+
+	const std::uint64_t indexOffset = out.tellp();
+
+	put32((std::uint32_t)frameIndex.size());
+	for (const IndexEntry &E : frameIndex) {
+		put32(E.mcs);
+		put8(E.kind);
+		put64(E.offset);
+	}
+
+	put64(indexOffset);
+	buffer.insert(buffer.end(), {'P', 'I', 'D', 'X'});
+	flush();
+
+	out.close();
+}
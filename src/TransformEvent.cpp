@@ -1,10 +1,11 @@
 #include<vector>
-#include <algorithm>
 
 #include "./headers/TransformEvent.h"
 #include "./headers/RandomNumberGenerators.h"
+#include "./headers/Registry.h"
+#include "./headers/SimClock.h"
 
-static std::vector<TransformEvent> transformEvents = std::vector<TransformEvent>();
+static Registry<TransformEvent> transformEvents;
 
 TransformEvent::TransformEvent(int id) {
 
@@ -18,36 +19,24 @@ void TransformEvent::generateNewTriggerTime() {
 		triggerMCS = (int) triggerMean;
 	}
 	else {
-		triggerMCS = (int)RandomNumberGenerators::rNormalDouble(triggerMean, triggerSD);
+		triggerMCS = (int)RandomNumberGenerators::rNormalDouble(triggerMean, triggerSD, id, RandomNumberGenerators::EVENT_TIME);
 	}
 
 }
 
 void TransformEvent::startTimer() {
-	mcsTimer = 0;
+	timerStartMCS = SimClock::now();
 	timerStart = true;
 	generateNewTriggerTime();
 }
 
-void TransformEvent::updateTimers() {
-
-	for (TransformEvent& T : transformEvents) {
-
-		if (T.timerStart) {
-			T.mcsTimer++;
-		}
-
-	}
-
+int TransformEvent::getTimer() const {
+	return timerStart ? SimClock::now() - timerStartMCS : 0;
 }
 
 int TransformEvent::addNewEvent(TransformEvent T) {
 
-	transformEvents.push_back(T);
-
-	std::sort(transformEvents.begin(), transformEvents.end(), [](const TransformEvent& lhs, const TransformEvent& rhs) {
-		return lhs.id < rhs.id;
-		});
+	transformEvents.add(T);
 
 	return 0;
 
@@ -58,5 +47,9 @@ int TransformEvent::getNumEvents() {
 }
 
 TransformEvent& TransformEvent::getEvent(int e) {
-	return transformEvents[e];
+	return transformEvents.get(e);
+}
+
+bool TransformEvent::isDefined(int e) {
+	return transformEvents.contains(e);
 }
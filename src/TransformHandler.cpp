@@ -1,6 +1,9 @@
 #include "./headers/TransformHandler.h"
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "./headers/SuperCell.h"
 #include "./headers/RandomNumberGenerators.h"
@@ -8,6 +11,18 @@
 
 static std::shared_ptr<SquareCellGrid> grid;
 
+// (first bordering site, SuperCell) pairs for transforms conditional on neighbours
+static std::vector<std::pair<int, int>> transformOrder;
+
+// Cells of the type being transformed, in ID order
+static std::vector<int> targets;
+
+// Sites a conditional spawn may pick from, once drawing at random has failed
+static std::vector<int> spawnSites;
+
+// Random draws of sites of the type before a conditional spawn lists the qualifying sites
+static const int SPAWN_ATTEMPTS = 32;
+
 void TransformHandler::initializeHandler(std::shared_ptr<SquareCellGrid> ptr) {
 	grid = ptr;
 }
@@ -16,6 +31,9 @@ void TransformHandler::runTransformLoop() {
 
 	for (int e = 0; e < TransformEvent::getNumEvents(); e++) {
 
+		if (!TransformEvent::isDefined(e))
+			continue;
+
 		TransformEvent &T = TransformEvent::getEvent(e);
 
 		if (T.triggered)
@@ -27,7 +45,7 @@ void TransformHandler::runTransformLoop() {
 			}
 		}
 
-		if (T.mcsTimer >= T.triggerMCS) {
+		if (T.getTimer() >= T.triggerMCS) {
 
 			if (T.reportFire)
 				std::cout << "Event " << T.id << " fired" << std::endl;
@@ -35,28 +53,31 @@ void TransformHandler::runTransformLoop() {
 			// Global transform
 			if (T.transformType == 0) {
 
-				for (int c = 0; c < SuperCell::getNumSupers(); c++) {
-					if (SuperCell::getCellType(c) == T.transformFrom) {
+				SuperCell::getTypeMembersSorted(T.transformFrom, targets);
 
-						if(SuperCell::isDead(c)) continue;
+				for (int c : targets) {
 
-						SuperCell::setCellType(c, T.transformTo);
-						if (T.updateColour)
-							SuperCell::generateNewColour(c);
-						if (T.updateDiv) {
-							SuperCell::setNextDiv(c, SuperCell::generateNewDivisionTime(c));
-							SuperCell::setMCS(c, 0);
-						}
-						if (T.volumeMult != 1.0) {
-							SuperCell::setTargetVolume(c, SuperCell::getTargetVolume(c) * T.volumeMult);
-						}
+					if(SuperCell::isDead(c)) continue;
+
+					SuperCell::setCellType(c, T.transformTo);
+					if (T.updateColour)
+						SuperCell::generateNewColour(c);
+					if (T.updateDiv) {
+						SuperCell::setNextDiv(c, SuperCell::generateNewDivisionTime(c));
+						SuperCell::setMCS(c, 0);
+					}
+					if (T.volumeMult != 1.0) {
+						SuperCell::setTargetVolume(c, SuperCell::getTargetVolume(c) * T.volumeMult);
 					}
 				}
 
 			}
 			// Transform, conditional on neighbours
-			else if (T.transformType == 1) {
+			else if (T.transformType == 1 && (T.transformTo == T.transformData || T.transformFrom == T.transformData || T.transformFrom == T.transformTo)) {
 
+				// When the types overlap, a transform can change which cells qualify, so sites are
+				// checked against the current types as the scan reaches them. A cell may cascade
+				// into its neighbours or be transformed once per bordering site.
 				for (int y = 1; y <= grid->interiorHeight; y++) {
 					for (int x = 1; x <= grid->interiorWidth; x++) {
 
@@ -85,6 +106,41 @@ void TransformHandler::runTransformLoop() {
 					}
 				}
 
+			}
+			else if (T.transformType == 1) {
+
+				// With distinct types no transform changes which cells qualify, so the candidates
+				// are found up front. Each is transformed once, in the order a row-by-row scan would
+				// first find one of its sites bordering the type, so draws are made in the same order.
+				transformOrder.clear();
+
+				for (int c : SuperCell::getTypeMembers(T.transformFrom)) {
+
+					if (SuperCell::isDead(c))
+						continue;
+
+					const int site = grid->firstSiteBorderingType(c, T.transformData);
+
+					if (site != -1)
+						transformOrder.push_back({site, c});
+				}
+
+				std::sort(transformOrder.begin(), transformOrder.end());
+
+				for (const auto &[site, c] : transformOrder) {
+
+					SuperCell::setCellType(c, T.transformTo);
+					if (T.updateColour)
+						SuperCell::generateNewColour(c);
+					if (T.updateDiv) {
+						SuperCell::setNextDiv(c, SuperCell::generateNewDivisionTime(c));
+						SuperCell::setMCS(c, 0);
+					}
+					if (T.volumeMult != 1.0) {
+						SuperCell::setTargetVolume(c, SuperCell::getTargetVolume(c) * T.volumeMult);
+					}
+				}
+
 			}
 
 			// Probabilistic transform
@@ -92,23 +148,22 @@ void TransformHandler::runTransformLoop() {
 
 				double pTransform = ((double)T.transformData / 100.0);
 
-				for (int c = 0; c < SuperCell::getNumSupers(); c++) {
+				SuperCell::getTypeMembersSorted(T.transformFrom, targets);
 
-					if (SuperCell::getCellType(c) == T.transformFrom) {
+				for (int c : targets) {
 
-						if(SuperCell::isDead(c)) continue;
+					if(SuperCell::isDead(c)) continue;
 
-						if (RandomNumberGenerators::rUnifProb() < pTransform) {
-							SuperCell::setCellType(c, T.transformTo);
-							if (T.updateColour)
-								SuperCell::generateNewColour(c);
-							if (T.updateDiv) {
-								SuperCell::setNextDiv(c, SuperCell::generateNewDivisionTime(c));
-								SuperCell::setMCS(c, 0);
-							}
-							if (T.volumeMult != 1.0) {
-								SuperCell::setTargetVolume(c, SuperCell::getTargetVolume(c) * T.volumeMult);
-							}
+					if (RandomNumberGenerators::rUnifProb(SuperCell::getID(c), RandomNumberGenerators::TRANSFORM, e) < pTransform) {
+						SuperCell::setCellType(c, T.transformTo);
+						if (T.updateColour)
+							SuperCell::generateNewColour(c);
+						if (T.updateDiv) {
+							SuperCell::setNextDiv(c, SuperCell::generateNewDivisionTime(c));
+							SuperCell::setMCS(c, 0);
+						}
+						if (T.volumeMult != 1.0) {
+							SuperCell::setTargetVolume(c, SuperCell::getTargetVolume(c) * T.volumeMult);
 						}
 					}
 				}
@@ -118,21 +173,16 @@ void TransformHandler::runTransformLoop() {
 			// Random Spawn on type
 			else if (T.transformType == 3) {
 
-				bool success = false;
-
-				while (!success) {
-
-					int x = RandomNumberGenerators::rUnifInt(1, grid->interiorWidth);
-					int y = RandomNumberGenerators::rUnifInt(1, grid->interiorHeight);
+				const int count = grid->getNumSitesOfType(T.transformFrom);
 
-					if (SuperCell::getCellType(grid->getCell(x, y)) == T.transformFrom) {
+				// Nothing to spawn on if the type holds no sites
+				if (count > 0) {
 
-						int newSuper = SuperCell::makeNewSuperCell(SuperCellTemplate::getTemplate(T.transformTo));
-						SuperCell::generateNewColour(newSuper);
-						grid->setCell(x, y, newSuper);
+					int site = grid->getSiteOfType(T.transformFrom, RandomNumberGenerators::rUnifInt(0, count - 1, T.id, RandomNumberGenerators::SPAWN));
 
-						success = true;
-					}
+					int newSuper = SuperCell::makeNewSuperCell(SuperCellTemplate::getTemplate(T.transformTo));
+					SuperCell::generateNewColour(newSuper);
+					grid->setCellAt(site, newSuper);
 				}
 
 			}
@@ -140,29 +190,35 @@ void TransformHandler::runTransformLoop() {
 			// Random spawn, conditional on subcell neighbours
 			else if (T.transformType == 4) {
 
-				bool success = false;
-				int attempts = 0;
+				const int count = grid->getNumSitesOfType(T.transformFrom);
+				int site = -1;
 
-				while (!success && (attempts < (grid->interiorWidth * grid->interiorHeight))) {
+				// Sites of the type are drawn directly, which mostly finds one with a neighbour of
+				// the other type quickly. If not, the sites that qualify are listed and one is drawn
+				// from those, which also tells when there are none.
+				for (int attempt = 0; attempt < SPAWN_ATTEMPTS && count > 0; attempt++) {
 
-					attempts++;
+					int draw = grid->getSiteOfType(T.transformFrom, RandomNumberGenerators::rUnifInt(0, count - 1, T.id, RandomNumberGenerators::SPAWN, attempt));
 
-					int x = RandomNumberGenerators::rUnifInt(1, grid->interiorWidth);
-					int y = RandomNumberGenerators::rUnifInt(1, grid->interiorHeight);
+					if (grid->siteBordersType(draw, T.transformData)) {
+						site = draw;
+						break;
+					}
+				}
 
-					if (SuperCell::getCellType(grid->getCell(x, y)) == T.transformFrom) {
+				if (site == -1 && count > 0) {
 
-						auto N = grid->getNeighboursCoords(x, y, T.transformData);
+					grid->getSitesBorderingType(T.transformFrom, T.transformData, spawnSites);
 
-						if (!N.empty()) {
+					if (!spawnSites.empty())
+						site = spawnSites[RandomNumberGenerators::rUnifInt(0, (int)spawnSites.size() - 1, T.id, RandomNumberGenerators::SPAWN, SPAWN_ATTEMPTS)];
+				}
 
-							int newSuper = SuperCell::makeNewSuperCell(SuperCellTemplate::getTemplate(T.transformTo));
-							SuperCell::generateNewColour(newSuper);
-							grid->setCell(x, y, newSuper);
+				if (site != -1) {
 
-							success = true;
-						}
-					}
+					int newSuper = SuperCell::makeNewSuperCell(SuperCellTemplate::getTemplate(T.transformTo));
+					SuperCell::generateNewColour(newSuper);
+					grid->setCellAt(site, newSuper);
 				}
 			}
 
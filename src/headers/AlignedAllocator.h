@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+/**
+ * @brief Minimal allocator returning storage aligned to a fixed boundary, so that
+ * flat simulation buffers start on a cache line.
+ *
+ * @tparam T Element type
+ * @tparam Align Alignment in bytes
+ */
+template <typename T, std::size_t Align = 64>
+struct AlignedAllocator {
+
+	using value_type = T;
+
+	template <typename U>
+	struct rebind {
+		using other = AlignedAllocator<U, Align>;
+	};
+
+	AlignedAllocator() noexcept {}
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Align> &) noexcept {}
+
+	T *allocate(std::size_t n) {
+		return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+	}
+
+	void deallocate(T *p, std::size_t) noexcept {
+		::operator delete(p, std::align_val_t(Align));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Align> &) const noexcept {
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Align> &) const noexcept {
+		return false;
+	}
+};
@@ -11,6 +11,7 @@ class CellDeathEvent {
     static int AddNewEvent(CellDeathEvent E);
     static int getNumEvents();   
     static CellDeathEvent& getEvent(int e); 
+    static bool isDefined(int e);
 
     int id;
     int fireOn = 0;
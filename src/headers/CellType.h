@@ -1,5 +1,7 @@
 #pragma once
 
+#include "AlignedAllocator.h"
+
 #include <vector>
 
 class CellType {
@@ -28,5 +30,33 @@ public:
 		
 	static void addType(CellType T);
 	static CellType& getType(int t);
+	static int getNumTypes();
+
+	static void buildJTable();
+
+	/**
+	 * @brief Adhesion energy between a site of type a and a neighbouring site of type b
+	 */
+	static double getJ(int a, int b) {
+		return jTable[a * jStride + b];
+	}
+
+	static const double *getJTable() {
+		return jTable.data();
+	}
+
+	static int getJStride() {
+		return jStride;
+	}
+
+	static int getJTableSize() {
+		return (int)jTable.size();
+	}
+
+private:
+
+	// Dense row-major copy of every J vector, rows padded to jStride entries
+	static inline std::vector<double, AlignedAllocator<double>> jTable;
+	static inline int jStride = 0;
 
 };
\ No newline at end of file
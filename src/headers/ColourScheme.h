@@ -17,7 +17,7 @@ public:
 	int bMin = 0;
 	int bMax = 255;
 
-	static std::vector<int> generateColour(int s);
+	static std::vector<int> generateColour(int s, int c);
 
 	ColourScheme(int id);
 	static void addScheme(ColourScheme T);
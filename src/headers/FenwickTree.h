@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * @brief Fenwick (binary indexed) tree of non-negative weights. Supports changing a weight and
+ * finding the entry a uniform draw over the running total falls in, both in O(log n).
+ */
+class FenwickTree {
+
+public:
+	/**
+	 * @brief Rebuild from a list of weights in O(n). Also clears rounding drift left by add().
+	 */
+	void build(const std::vector<double> &weights) {
+
+		size = (int)weights.size();
+		tree.assign(size + 1, 0.0);
+
+		for (int i = 0; i < size; i++) {
+			tree[i + 1] += weights[i];
+
+			const int parent = (i + 1) + ((i + 1) & -(i + 1));
+			if (parent <= size)
+				tree[parent] += tree[i + 1];
+		}
+
+		sum = 0.0;
+		for (double w : weights) {
+			sum += w;
+		}
+
+		topBit = 1;
+		while (topBit * 2 <= size) {
+			topBit *= 2;
+		}
+	}
+
+	void add(int i, double delta) {
+
+		sum += delta;
+
+		for (int k = i + 1; k <= size; k += k & -k) {
+			tree[k] += delta;
+		}
+	}
+
+	double total() const {
+		return sum;
+	}
+
+	/**
+	 * @brief Entry i such that the weights before it sum to at most u, and with it to more than u
+	 *
+	 * @param u Value in [0, total)
+	 * @return int
+	 */
+	int find(double u) const {
+
+		int pos = 0;
+
+		for (int step = topBit; step > 0; step >>= 1) {
+			if (pos + step <= size && tree[pos + step] <= u) {
+				pos += step;
+				u -= tree[pos];
+			}
+		}
+
+		return (pos < size) ? pos : size - 1;
+	}
+
+private:
+	std::vector<double> tree;
+	double sum = 0.0;
+	int size = 0;
+	int topBit = 1;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+
+#include "SquareCellGrid.h"
+
+class LifecycleHandler {
+    public:
+
+    static void initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int compactEvery);
+    static void runLifecycleLoop(int m);
+
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief Philox4x32-10 counter-based generator (Salmon et al., Random123).
+ *
+ * A stateless bijection from a 128 bit counter to 128 random bits, under a 64 bit key.
+ * Any draw can be computed independently of every other draw, in any order, on any thread.
+ */
+class Philox4x32 {
+
+public:
+	using Counter = std::array<std::uint32_t, 4>;
+	using Key = std::array<std::uint32_t, 2>;
+
+	static Counter generate(Counter ctr, Key key) {
+
+		for (int r = 0; r < 10; r++) {
+
+			if (r > 0) {
+				key[0] += W0;
+				key[1] += W1;
+			}
+
+			const std::uint64_t p0 = (std::uint64_t)M0 * ctr[0];
+			const std::uint64_t p1 = (std::uint64_t)M1 * ctr[2];
+
+			ctr = {(std::uint32_t)(p1 >> 32) ^ ctr[1] ^ key[0], (std::uint32_t)p1,
+				   (std::uint32_t)(p0 >> 32) ^ ctr[3] ^ key[1], (std::uint32_t)p0};
+		}
+
+		return ctr;
+	}
+
+private:
+	static constexpr std::uint32_t M0 = 0xD2511F53;
+	static constexpr std::uint32_t M1 = 0xCD9E8D57;
+	static constexpr std::uint32_t W0 = 0x9E3779B9;
+	static constexpr std::uint32_t W1 = 0xBB67AE85;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief PNG encoder with its own deflate: greedy LZ77 matching coded with the fixed Huffman
+ * tables. Rows are pulled from a callback in bands that are compressed independently, on
+ * several threads if asked, so only one band per thread is ever held uncompressed.
+ */
+class PngWriter {
+
+public:
+	// Fills one row of raw samples, RGB triples or palette indices, without the filter byte
+	using RowSource = std::function<void(int y, uint8_t *row)>;
+
+	static void writeRGB(std::ostream &out, int width, int height, const RowSource &rows, unsigned int threads = 1);
+	static void writeRGB(std::ostream &out, int width, int height, const uint8_t *rgb, unsigned int threads = 1);
+	static void writeIndexed(std::ostream &out, int width, int height, const std::vector<uint8_t> &palette, const RowSource &rows, unsigned int threads = 1);
+
+	static const int MAX_PALETTE = 256;
+
+private:
+	// Compressed bytes and Adler-32 of the raw bytes of one band
+	struct Band {
+		std::vector<uint8_t> data;
+		std::uint32_t adler = 1;
+		std::size_t rawSize = 0;
+	};
+
+	static void writeImage(std::ostream &out, int width, int height, uint8_t colourType, const std::vector<uint8_t> &palette, int rowBytes, int pixelBytes, const RowSource &rows, unsigned int threads);
+	static void compressBand(int y0, int y1, int rowBytes, int pixelBytes, const RowSource &rows, Band &B);
+	static void writeChunk(std::ostream &out, const char *type, const uint8_t *data, std::size_t size);
+};
@@ -1,15 +1,140 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Philox.h"
+#include "Xoshiro256.h"
+
 class RandomNumberGenerators {
 
 public:
 
-	static double rUnifProb();
-	static int rUnifInt(int min, int max);
+	// Engine used by every thread. Any generator with operator(), seed(seed, stream) and a
+	// constexpr default constructor can be dropped in here.
+	using Engine = Xoshiro256StarStar;
+
+	static void setSeed(std::uint64_t s);
+	static std::uint64_t getSeed();
+	static void setThreadStream(unsigned int stream);
+
+	static Engine &engine() {
+		if (!threadState.seeded)
+			seedThread();
+		return threadState.engine;
+	}
+
+	/**
+	 * @brief Generate a random uniform number in [0.0, 1.0)
+	 *
+	 * @return double
+	 */
+	static double rUnifProb() {
+		return (engine()() >> 11) * 0x1.0p-53;
+	}
+
+	/**
+	 * @brief Generate a random uniform integer between min and max, inclusive
+	 *
+	 * @param min
+	 * @param max
+	 * @return int
+	 */
+	static int rUnifInt(int min, int max) {
+		return min + (int)bounded(engine(), (std::uint32_t)(max - min) + 1u);
+	}
+
 	static double rNormalDouble(double mu, double sdev);
 
+	static void fillUnifInt(int *out, std::size_t n, int min, int max);
+	static void fillUnifProb(double *out, std::size_t n);
+
+	// What a keyed draw is used for, so that draws for different purposes never share a counter
+	enum Purpose : std::uint32_t {
+		PROPOSAL = 0,
+		DEATH = 1,
+		TRANSFORM = 2,
+		SPAWN = 3,
+		DIVISION_TIME = 4,
+		DIVISION_AXIS = 5,
+		COLOUR = 6,
+		EVENT_TIME = 7,
+		SWEEP_ORDER = 8
+	};
+
+	static void setCounterMode(bool on);
+	static bool isCounterMode() {
+		return counterMode;
+	}
+
+	static void setStep(std::uint32_t mcs);
+	static std::uint32_t getStep() {
+		return step;
+	}
+
+	/**
+	 * @brief 128 random bits that depend only on (seed, current MCS, id, purpose, draw)
+	 */
+	static std::array<std::uint32_t, 4> counterBlock(std::uint32_t id, Purpose p, std::uint32_t draw = 0) {
+		return Philox4x32::generate({step, id, (std::uint32_t)p, draw}, counterKey);
+	}
+
+	/**
+	 * @brief Map a random 32 bit word to an integer between min and max, inclusive.
+	 * The bias is below range / 2^32.
+	 */
+	static int wordToInt(std::uint32_t w, int min, int max) {
+		return min + (int)(((std::uint64_t)w * ((std::uint32_t)(max - min) + 1u)) >> 32);
+	}
+
+	/**
+	 * @brief Map a random 32 bit word to a uniform number in [0.0, 1.0)
+	 */
+	static double wordToProb(std::uint32_t w) {
+		return w * 0x1.0p-32;
+	}
+
+	static double rUnifProb(std::uint32_t id, Purpose p, std::uint32_t draw = 0);
+	static int rUnifInt(int min, int max, std::uint32_t id, Purpose p, std::uint32_t draw = 0);
+	static double rNormalDouble(double mu, double sdev, std::uint32_t id, Purpose p, std::uint32_t draw = 0);
+
 private:
 
+	static inline bool counterMode = false;
+	static inline std::uint32_t step = 0;
+	static inline Philox4x32::Key counterKey = {0, 0};
+
+	struct ThreadState {
+		constexpr ThreadState() : engine(), seeded(false) {}
+
+		Engine engine;
+		bool seeded;
+	};
+
+	static inline thread_local ThreadState threadState;
+
+	static void seedThread();
+
+	/**
+	 * @brief Unbiased integer in [0, range) using Lemire's multiply and reject method
+	 */
+	static std::uint32_t bounded(Engine &E, std::uint32_t range) {
+
+		std::uint64_t m = (E() >> 32) * range;
+		std::uint32_t l = (std::uint32_t)m;
+
+		if (l < range) {
+			std::uint32_t t = (0u - range) % range;
+			while (l < t) {
+				m = (E() >> 32) * range;
+				l = (std::uint32_t)m;
+			}
+		}
+
+		return (std::uint32_t)(m >> 32);
+	}
+
 	RandomNumberGenerators() {}
 
 };
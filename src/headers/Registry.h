@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+/**
+ * @brief Objects indexed by their id. Each object is stored in slot id when added, so lookups
+ * need no sorting and adding is amortized O(1). Storage is a deque, which never moves existing
+ * objects as it grows, so references returned by get stay valid.
+ *
+ * T needs a public int id and a constructor taking an id, used to fill the slots of ids that are
+ * not defined yet.
+ */
+template <typename T>
+class Registry {
+
+public:
+	/**
+	 * @brief Store an object in the slot of its id, replacing any object already defined there
+	 */
+	T &add(const T &item) {
+
+		while ((int)items.size() <= item.id) {
+			items.emplace_back((int)items.size());
+			defined.push_back(false);
+		}
+
+		items[item.id] = item;
+		defined[item.id] = true;
+
+		return items[item.id];
+	}
+
+	bool contains(int id) const {
+		return id >= 0 && id < (int)items.size() && defined[id];
+	}
+
+	T &get(int id) {
+		return items[id];
+	}
+
+	int size() const {
+		return (int)items.size();
+	}
+
+	typename std::deque<T>::iterator begin() {
+		return items.begin();
+	}
+
+	typename std::deque<T>::iterator end() {
+		return items.end();
+	}
+
+private:
+	std::deque<T> items;
+	std::vector<bool> defined;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <memory>
+
+#include "SquareCellGrid.h"
+
+class RejectionFreeSweep {
+    public:
+
+    static void initializeHandler(std::shared_ptr<SquareCellGrid> ptr);
+    static void runSweep();
+
+};
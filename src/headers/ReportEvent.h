@@ -13,6 +13,7 @@ public:
 
     static ReportEvent &getEvent(int e);
     static int getNumEvents();
+    static bool isDefined(int e);
 
     int id;
     int triggerOn = 0;
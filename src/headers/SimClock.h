@@ -0,0 +1,23 @@
+#pragma once
+
+/**
+ * @brief Count of MCS completed, advanced once at the end of each MCS. Ages and timers are stored
+ * as the MCS they started at and read against this clock, so nothing has to be incremented per
+ * cell or per event.
+ */
+class SimClock {
+
+public:
+	static int now() {
+		return mcs;
+	}
+
+	static void tick() {
+		mcs++;
+	}
+
+private:
+	static inline int mcs = 0;
+
+	SimClock() {}
+};
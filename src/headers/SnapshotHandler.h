@@ -0,0 +1,15 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "SquareCellGrid.h"
+
+class SnapshotHandler {
+    public:
+
+    static void initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int every, unsigned int threads, std::string baseName);
+    static void runSnapshotLoop(int m);
+    static void shutdownHandler();
+
+};
@@ -1,9 +1,14 @@
 #pragma once
 
+#include "AlignedAllocator.h"
+#include "SuperCell.h"
 #include "Vector2D.h"
 
 #include <vector>
 #include <cstdint>
+#include <ostream>
+#include <span>
+#include <utility>
 
 class SquareCellGrid {
 
@@ -13,16 +18,156 @@ public:
 	int interiorWidth;
 	int interiorHeight;
 
+	// Distance between vertically adjacent sites in the lattice buffer
+	int rowStride;
+
 	double BOLTZ_TEMP;
 	double OMEGA;
 	double LAMBDA;
 
+	// Copies made by one tile of a parallel sweep, waiting to be committed
+	struct TileJournal {
+		struct Change {
+			int site;
+			int previous;
+			int next;
+		};
+
+		std::vector<Change> changes;
+
+		// Net volume change of each SuperCell touched by the tile
+		std::vector<std::pair<int, int>> volumeDelta;
+	};
+
+	// Copy of the lattice and of the colour of every SuperCell, taken by the simulation so that
+	// it can be displayed while the simulation carries on. The lattice is split into spans of
+	// SPAN sites, each stamped with the epoch of the capture that first saw it change, so a
+	// frame can be brought up to date, and redrawn, one changed span at a time.
+	struct LatticeFrame {
+		std::vector<int> lattice;
+		std::vector<std::uint32_t> palette;
+		std::vector<std::uint32_t> spanEpoch;
+		std::uint32_t epoch = 0;
+	};
+
+	static const int SPAN = 16;
+
 	SquareCellGrid(int w, int h, int boundarySC, int spaceSC);
 
-	int getCell(int row, int col);
+	int index(int x, int y) const {
+		return y * rowStride + x;
+	}
+
+	int getCell(int row, int col) const {
+		return lattice[index(row, col)];
+	}
+
+	int getCellAt(int i) const {
+		return lattice[i];
+	}
 
 	void setCell(int row, int col, int superCell);
-	
+	void setCellAt(int i, int superCell);
+	void remapSuperCells(const std::vector<int> &remap);
+
+	// Interior sites with at least one Moore neighbour in a different SuperCell. Only these
+	// sites can make a copy, so proposals can be drawn from them alone.
+	int getNumBoundarySites() const {
+		return (int)boundarySites.size();
+	}
+
+	int getBoundarySite(int k) const {
+		return boundarySites[k];
+	}
+
+	// Boundary sites owned by one SuperCell, as a linked list ending in -1
+	int firstCellBoundarySite(int c) const {
+		return (c < (int)cellBoundaryHead.size()) ? cellBoundaryHead[c] : -1;
+	}
+
+	int nextCellBoundarySite(int i) const {
+		return cellBoundaryNext[i];
+	}
+
+	// Every interior site owned by one SuperCell, as a linked list ending in -1
+	int firstCellSite(int c) const {
+		return (c < (int)cellSiteHead.size()) ? cellSiteHead[c] : -1;
+	}
+
+	int nextCellSite(int i) const {
+		return cellSiteNext[i];
+	}
+
+	void getCellSites(int c, std::vector<int> &out) const;
+
+	// Running sums over the interior sites of a SuperCell, kept current by setCellAt
+	struct CellMoments {
+		std::int64_t n = 0;
+		std::int64_t x = 0;
+		std::int64_t y = 0;
+		std::int64_t xx = 0;
+		std::int64_t yy = 0;
+		std::int64_t xy = 0;
+	};
+
+	// Centroid, short axis and elongation of a SuperCell, from its moments
+	struct CellShape {
+		double xBar;
+		double yBar;
+		double shortAxisGrad;
+		double elongation;
+	};
+
+	CellMoments getCellMoments(int c) const {
+		return (c < (int)cellMoments.size()) ? cellMoments[c] : CellMoments();
+	}
+
+	CellShape getCellShape(int c) const;
+
+	// One SuperCell bordering another. out counts Moore neighbour pairs from interior sites of the
+	// owner into sites of cell, in the pairs the other way round.
+	struct Contact {
+		int cell;
+		int out;
+		int in;
+	};
+
+	// SuperCells bordering c, kept current by setCellAt
+	const std::vector<Contact> &getContacts(int c) const {
+		return (c < (int)cellContacts.size()) ? cellContacts[c] : noContacts;
+	}
+
+	int getContactCount(int a, int b) const;
+	bool bordersType(int c, int type) const;
+	int countNeighboursOfType(int c, int type) const;
+	int firstSiteBorderingType(int c, int type) const;
+
+	// Interior sites grouped by the type of their SuperCell, for drawing a site of a type in O(1).
+	// getNumSitesOfType brings the grouping up to date with setCellType, and must be called before
+	// getSiteOfType.
+	int getNumSitesOfType(int type);
+
+	int getSiteOfType(int type, int k) const {
+		return typeSites[typeSiteStart[type] + k];
+	}
+
+	bool siteBordersType(int i, int type) const;
+	void getSitesBorderingType(int type, int other, std::vector<int> &out) const;
+
+	bool isInterior(int i) const {
+		return boundarySlot[i] != -2;
+	}
+
+	int neighbourOf(int i, int n) const {
+		return i + neighbourOffsets[n];
+	}
+
+	// Incremented by every setCellAt, so that cached state derived from the lattice can tell
+	// whether it is stale
+	std::uint64_t getLatticeRevision() const {
+		return latticeRevision;
+	}
+
 	std::vector<int> getNeighboursSuperCells(int row, int col);
 	std::vector<int> getNeighboursTypes(int row, int col);
 	std::vector<Vector2D<int>> getNeighboursCoords(int row, int col);
@@ -34,15 +179,169 @@ public:
 	int cleaveCell(int c);
 
 	int moveCell(int x, int y);
+	int moveCell(int x, int y, int neighbour, double accept);
+	int moveCellAt(int site, int neighbour, double accept);
+	int moveCellInTile(int x, int y, int neighbour, double accept, TileJournal &J);
+	int moveCellInTile(int x, int y, TileJournal &J);
+	void commitTile(TileJournal &J);
 
 	double getAdhesionDelta(int sourceX, int sourceY, int destX, int destY);
 	double getVolumeDelta(int sourceX, int sourceY, int destX, int destY);
 
+	double getAdhesionDeltaAt(int dest, int sourceSuper, int destSuper) const;
+	double getVolumeDeltaAt(int sourceSuper, int destSuper) const;
+
+	/**
+	 * @brief Whether origin may copy itself over target at all
+	 */
+	bool canCopy(int origin, int target) const {
+		return target != origin &&
+			   !SuperCell::isStatic(target) &&
+			   !SuperCell::isStatic(origin) &&
+			   !SuperCell::isDead(origin);
+	}
+
+	double getCopyAdhesion(int source, int neighbour) const;
+	double getCopyProbability(int source, int neighbour) const;
+	double getCopyProbability(int source, int neighbour, double adhesion) const;
+
+	void setIntegerEnergy(bool on);
+	bool isIntegerEnergy() const {
+		return integerEnergy;
+	}
+
 	void fullTextureRefresh();
-	std::vector<uint8_t> getPixels();
+	std::span<const uint8_t> getPixels() const;
+
+	void captureFrame(LatticeFrame &F);
+	void colourFrame(const LatticeFrame &F, uint8_t *out, std::uint32_t since, std::vector<std::pair<int, int>> &rows) const;
+	void writeFramePng(std::ostream &out, const LatticeFrame &F, unsigned int threads) const;
 
 protected:
 
-	double calculateRawImageMoment(std::vector<Vector2D<int>> data, int iO, int jO);
+	// Lattice of SuperCell IDs, row-major, rows padded to a whole number of cache lines
+	std::vector<int, AlignedAllocator<int>> lattice;
+
+	// Index offsets of the Moore neighbourhood, in the same order as getNeighboursCoords
+	int neighbourOffsets[8];
+	int neighbourDX[8];
+	int neighbourDY[8];
+
+	std::vector<uint8_t> pixels;
+
+	// Number of Moore neighbours of each site that belong to a different SuperCell
+	std::vector<uint8_t> neighbourDiffs;
+
+	// Boundary sites, and the position of each site in that list. -1 for interior sites not in
+	// the list, -2 for the frame, which is never in it.
+	std::vector<int> boundarySites;
+	std::vector<int> boundarySlot;
+
+	// The same sites split by owning SuperCell, as doubly linked lists threaded through the
+	// lattice so that moving a site between cells never allocates. A previous link of -2 marks a
+	// site that is in no list.
+	std::vector<int> cellBoundaryHead;
+	std::vector<int> cellBoundaryNext;
+	std::vector<int> cellBoundaryPrev;
+
+	// Every interior site split by owning SuperCell, linked the same way
+	std::vector<int> cellSiteHead;
+	std::vector<int> cellSiteNext;
+	std::vector<int> cellSitePrev;
+
+	std::vector<CellMoments> cellMoments;
+
+	// Contact graph, with neighbour pairs inside one SuperCell counted separately
+	std::vector<std::vector<Contact>> cellContacts;
+	std::vector<int> selfContacts;
+	static inline const std::vector<Contact> noContacts;
+
+	// Every interior site, in one block per cell type, block t running from typeSiteStart[t] to
+	// typeSiteStart[t + 1]. A site changes block by swaps at the block edges, so moving it never
+	// allocates. The sites of a SuperCell sit in the block given by cellSiteType, which lags
+	// behind setCellType until syncTypeSites.
+	std::vector<int> typeSites;
+	std::vector<int> typeSitePos;
+	std::vector<int> typeSiteStart;
+	std::vector<int> cellSiteType;
+
+	std::uint64_t latticeRevision = 0;
+
+	// Epoch of the next frame capture, and the epoch at which each span of the lattice last
+	// changed on screen, through a copy or through the colour of a cell on it
+	std::uint32_t frameEpoch = 1;
+	std::vector<std::uint32_t> spanEpoch;
+	std::vector<std::uint32_t> capturedPalette;
+
+	void rebuildBoundarySites();
+	void updateBoundarySite(int i);
+	void removeCellBoundarySite(int i, int superCell);
+
+	void rebuildCellSites();
+	void addCellSite(int i, int superCell);
+	void removeCellSite(int i, int superCell);
+	void addMoments(int i, int superCell, int sign);
+
+	void rebuildContacts();
+	void addContacts(int a, int b, int dOut, int dIn);
+	void updateContacts(int i, int originalSuper, int superCell);
+
+	void rebuildTypeSites();
+	void syncTypeSites();
+	void addTypeBlocks(int type);
+	int typeBlockOf(int superCell);
+	void moveTypeSite(int i, int from, int to);
+
+	void getCellCoords(int c, std::vector<Vector2D<int>> &out) const;
+
+	void colourSites(const int *sites, const std::uint32_t *palette, uint8_t *out) const;
+
+	double copyDeltaH(int dest, int origin, int target, int originVol, int targetVol) const;
+	double copyDeltaH(int origin, int target, double adhesion, int originVol, int targetVol) const;
+
+	// Copy policies for tryCopy: where SuperCell volumes are read from and how a copy is applied
+	struct DirectCopy {
+		SquareCellGrid &grid;
+		int volume(int c) const;
+		void copy(int dest, int superCell);
+	};
+
+	struct JournalCopy {
+		SquareCellGrid &grid;
+		TileJournal &journal;
+		int volume(int c) const;
+		void copy(int dest, int superCell);
+	};
+
+	template <typename AcceptDraw, typename Copy>
+	int tryCopy(int source, int neighbour, AcceptDraw &&acceptDraw, Copy &&apply);
+
+	double volumeDeltaKernel(int sourceSuper, int destSuper, int sourceVol, int destVol) const;
+	int volumeDeltaSites(int sourceSuper, int destSuper, int sourceVol, int destVol) const;
+
+	template <typename T>
+	T adhesionDelta(const T *J, int dest, int sourceSuper, int destSuper) const;
+
+	template <int STRIDE, typename T>
+	T adhesionDeltaKernel(const T *J, int dest, int sourceSuper, int destSuper) const;
+
+	// Fixed-point Hamiltonian: energies in units of 1 / energyScale, with OMEGA folded into the J
+	// table, and acceptance as an integer compare against a table of thresholds
+	bool integerEnergy = false;
+	int energyScale = 1;
+	std::vector<std::int64_t> jFixed;
+	std::int64_t lambdaFixed = 0;
+	std::vector<std::uint32_t> acceptThreshold;
+
+	std::int64_t copyDeltaHFixed(int dest, int origin, int target, int originVol, int targetVol) const;
+	std::int64_t copyDeltaHFixed(int origin, int target, std::int64_t adhesion, int originVol, int targetVol) const;
+
+	/**
+	 * @brief Fixed-point acceptance test. u is turned back into the 32 bit word it came from.
+	 */
+	bool acceptFixed(std::int64_t deltaH, double u) const {
+		return deltaH <= 0 ||
+			   (deltaH < (std::int64_t)acceptThreshold.size() && (std::uint32_t)(u * 0x1.0p32) < acceptThreshold[deltaH]);
+	}
 
-};
\ No newline at end of file
+};
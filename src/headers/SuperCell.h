@@ -1,7 +1,10 @@
 #pragma once
 
 #include "CellType.h"
+#include "SimClock.h"
 #include "SuperCellTemplate.h"
+#include <array>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -15,9 +18,17 @@ public:
 
 	static int getID(int i);
 
-	static bool isStatic(int c);
-	static bool doDivide(int c);
-	static bool ignoreVolume(int c);
+	static void reserve(int capacity);
+
+	static bool isStatic(int c) {
+		return table.flags[c] & FLAG_STATIC;
+	}
+	static bool doDivide(int c) {
+		return table.flags[c] & FLAG_DIVIDE;
+	}
+	static bool ignoreVolume(int c) {
+		return table.flags[c] & FLAG_IGNORE_VOLUME;
+	}
 	static bool ignoreSurface(int c);
 
 	static double getDivMean(int c);
@@ -32,52 +43,151 @@ public:
 
 	static int getMCS(int c);
 	static void setMCS(int c, int i);
-	static void increaseMCS();
 	static int getNextDiv(int c);
 	static void setNextDiv(int c, int i);
 
-	static int getTargetVolume(int c);
+	// Cells whose division time may have changed since the division scheduler last looked
+	static void takeRescheduled(std::vector<int> &out);
+
+	static int getTargetVolume(int c) {
+		return table.targetVolume[c];
+	}
 	static void setTargetVolume(int i, int target);
 
-	static void changeVolume(int i, int delta);
+	static void changeVolume(int i, int delta) {
+		table.volume[i] += delta;
+	}
 	static void setVolume(int i, int v);
-	static int getVolume(int i);
+	static int getVolume(int i) {
+		return table.volume[i];
+	}
 
-	static int getCellType(int c);
+	static int getCellType(int c) {
+		return table.type[c];
+	}
 	static void setCellType(int c, int t);
 
-	static bool isCountable(int c);
+	static bool isCountable(int c) {
+		return table.flags[c] & FLAG_COUNTABLE;
+	}
 
 	static std::vector<double> &getJ(int c);
 
-	static int getNumSupers();
+	static int getNumSupers() {
+		return (int)table.type.size();
+	}
 
 	static int getColourScheme(int c);
 	static void setColour(int i, int r, int g, int b, int a);
 	static void setColour(int i, std::vector<int> col);
 	static std::vector<int> getColour(int i);
+
+	// Colour of every SuperCell packed as the bytes of an opaque RGBA pixel, indexed by ID, so
+	// a frame can be coloured straight from the lattice
+	static const std::uint32_t *getPalette() {
+		return table.pixel.data();
+	}
 	static void generateNewColour(int c);
 
 	static int generateNewDivisionTime(int c);
 
-	static bool isDead(int c);
+	static bool isDead(int c) {
+		return table.dead[c];
+	}
 	static void setDead(int c, bool d);
 
-private:
-	int ID;
-	int generation;
-
-	int cellType = 0;
-
-	int targetVolume;
-	int volume = 0;
+	// Slot of a retired cell, waiting to be reused by makeNewSuperCell. Free slots are also dead.
+	static bool isFree(int c) {
+		return table.flags[c] & FLAG_FREE;
+	}
+
+	static int retireDead();
+	static int getNumFree() {
+		return (int)freeSlots.size();
+	}
+	static int getRetiredDead(int type);
+
+	// Cells of each type that have not been retired, dead ones included, in no particular order
+	static const std::vector<int> &getTypeMembers(int t) {
+		return (t >= 0 && t < (int)typeMembers.size()) ? typeMembers[t] : noMembers;
+	}
+	static void getTypeMembersSorted(int t, std::vector<int> &out);
+
+	static int getLiveCount(int t) {
+		return (t >= 0 && t < (int)liveByType.size()) ? liveByType[t] : 0;
+	}
+	static int getDeadCount(int t);
+	static int getLiveCountable();
+	static std::vector<int> compact();
+
+	// Incremented whenever a property that enters the Hamiltonian is set directly. Volume
+	// changes made by copies go through changeVolume and are not counted.
+	static std::uint64_t getRevision() {
+		return revision;
+	}
+
+	// Incremented by each compaction, after which anything held by SuperCell index is stale
+	static std::uint64_t getCompactions() {
+		return compactions;
+	}
 
-	int lastDivMCS = 0;
-	int nextDivMCS = 9999999;
-
-	bool dead = false;
-
-	SuperCell(int type, int generation, int targetVolume);
-
-	std::vector<int> colour = std::vector<int>(4, 255);
+private:
+	// Per-cell flag bits, cached from the CellType of the cell
+	enum : uint8_t {
+		FLAG_STATIC = 1 << 0,
+		FLAG_IGNORE_VOLUME = 1 << 1,
+		FLAG_DIVIDE = 1 << 2,
+		FLAG_COUNTABLE = 1 << 3,
+		FLAG_FREE = 1 << 4
+	};
+
+	// Struct-of-arrays store, indexed by SuperCell ID. Slots are reused once their cell is
+	// retired, so the stable identity of a cell is its entry in the ID column.
+	struct CellTable {
+		std::vector<int> type;
+		std::vector<int> volume;
+		std::vector<int> targetVolume;
+		std::vector<uint8_t> dead;
+		std::vector<uint8_t> flags;
+
+		std::vector<int> ID;
+		std::vector<int> generation;
+
+		// SimClock time of the last division, so the age of a cell is read rather than counted
+		std::vector<int> lastDivMCS;
+		std::vector<int> nextDivMCS;
+		std::vector<std::array<int, 4>> colour;
+		std::vector<std::uint32_t> pixel;
+
+		// Position of the cell in the member list of its type, -1 once retired
+		std::vector<int> memberSlot;
+	};
+
+	static inline CellTable table;
+	static inline std::uint64_t revision = 0;
+	static inline std::uint64_t compactions = 0;
+
+	// Next external ID to hand out. External IDs are never reused.
+	static inline int nextID = 0;
+
+	// Cells killed but not yet retired, retired slots free for reuse, and retired cells by type
+	static inline std::vector<int> dying;
+	static inline std::vector<int> freeSlots;
+	static inline std::vector<int> retiredByType;
+
+	static inline std::vector<int> rescheduled;
+
+	// Per-type membership, kept in sync by makeNewSuperCell, setCellType, setDead and retireDead
+	static inline std::vector<std::vector<int>> typeMembers;
+	static inline std::vector<int> liveByType;
+	static inline std::vector<int> deadByType;
+	static inline const std::vector<int> noMembers;
+
+	static void addMember(int c, int t);
+	static void removeMember(int c, int t);
+
+	static uint8_t typeFlags(int t);
+	static std::uint32_t packPixel(const std::array<int, 4> &colour);
+
+	SuperCell() {}
 };
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+
+#include "SquareCellGrid.h"
+
+class SweepHandler {
+    public:
+
+    // How source sites are chosen for copy attempts
+    enum Mode {
+        RANDOM_SITE = 0,
+        BOUNDARY_SITE = 1,
+        REJECTION_FREE = 2
+    };
+
+    static void initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int threads, unsigned int mode);
+    static void runSweep();
+    static void shutdownHandler();
+
+};
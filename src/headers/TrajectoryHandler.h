@@ -0,0 +1,15 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "SquareCellGrid.h"
+
+class TrajectoryHandler {
+    public:
+
+    static void initializeHandler(std::shared_ptr<SquareCellGrid> ptr, unsigned int every, unsigned int keyframeEvery, std::string baseName);
+    static void runTrajectoryLoop(int m);
+    static void shutdownHandler();
+
+};
@@ -10,19 +10,22 @@ public:
 
 	static int addNewEvent(TransformEvent T);
 
-	static void updateTimers();
-
 	static TransformEvent& getEvent(int e);
 
 	static int getNumEvents();
+	static bool isDefined(int e);
 
 	void generateNewTriggerTime();
 	void startTimer();
 
+	// MCS since the timer was started, 0 if it has not been
+	int getTimer() const;
+
 	int id;
 
-	int mcsTimer = 0;
-	
+	// SimClock time the timer was started at
+	int timerStartMCS = 0;
+
 
 	bool triggered = false;
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+
+/**
+ * @brief Lock-free handoff of the latest value from one producer thread to one consumer thread.
+ * The producer fills back() and publishes it; the consumer takes the newest published value
+ * into front(). Neither side ever waits, and values the consumer was too slow to take are
+ * overwritten. Buffers are reused, so once they have grown to size nothing is allocated.
+ */
+template <typename T>
+class TripleBuffer {
+
+public:
+	/**
+	 * @brief Buffer the producer writes the next value into
+	 */
+	T &back() {
+		return buffers[backIndex];
+	}
+
+	/**
+	 * @brief Hand the back buffer to the consumer, taking the spare buffer in exchange
+	 */
+	void publish() {
+		backIndex = spare.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	/**
+	 * @brief Move the newest published value into front(), if one has arrived since the last call
+	 *
+	 * @return bool Whether front() changed
+	 */
+	bool consume() {
+
+		if (!(spare.load(std::memory_order_relaxed) & FRESH))
+			return false;
+
+		frontIndex = spare.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+
+		return true;
+	}
+
+	/**
+	 * @brief Buffer holding the value the consumer last took
+	 */
+	const T &front() const {
+		return buffers[frontIndex];
+	}
+
+private:
+	static constexpr unsigned int INDEX = 3;
+	static constexpr unsigned int FRESH = 4;
+
+	T buffers[3];
+
+	// Index of the buffer held by neither side, flagged when it holds an unread value
+	std::atomic<unsigned int> spare{1};
+
+	unsigned int backIndex = 0;
+	unsigned int frontIndex = 2;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief xoshiro256** 1.0 generator (Blackman & Vigna). Satisfies UniformRandomBitGenerator,
+ * so it can drive the standard distributions.
+ *
+ * Streams are separated with the 2^128 jump, so stream k of a seed never overlaps stream j.
+ */
+class Xoshiro256StarStar {
+
+public:
+	using result_type = std::uint64_t;
+
+	constexpr Xoshiro256StarStar() : s{0, 0, 0, 0} {}
+
+	Xoshiro256StarStar(std::uint64_t seed, std::uint64_t stream = 0) {
+		this->seed(seed, stream);
+	}
+
+	static constexpr result_type min() {
+		return 0;
+	}
+
+	static constexpr result_type max() {
+		return std::numeric_limits<result_type>::max();
+	}
+
+	/**
+	 * @brief Seed the state from a 64 bit seed through splitmix64, then advance to the requested stream
+	 */
+	void seed(std::uint64_t seed, std::uint64_t stream = 0) {
+
+		for (int i = 0; i < 4; i++) {
+			seed += 0x9E3779B97F4A7C15ull;
+			std::uint64_t z = seed;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			s[i] = z ^ (z >> 31);
+		}
+
+		for (std::uint64_t j = 0; j < stream; j++) {
+			jump();
+		}
+	}
+
+	result_type operator()() {
+
+		const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+		const std::uint64_t t = s[1] << 17;
+
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+
+		return result;
+	}
+
+	/**
+	 * @brief Advance the state by 2^128 draws
+	 */
+	void jump() {
+
+		static const std::uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+
+		std::uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+		for (std::uint64_t J : JUMP) {
+			for (int b = 0; b < 64; b++) {
+				if (J & (std::uint64_t(1) << b)) {
+					s0 ^= s[0];
+					s1 ^= s[1];
+					s2 ^= s[2];
+					s3 ^= s[3];
+				}
+				(*this)();
+			}
+		}
+
+		s[0] = s0;
+		s[1] = s1;
+		s[2] = s2;
+		s[3] = s3;
+	}
+
+private:
+	std::uint64_t s[4];
+
+	static std::uint64_t rotl(std::uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+};
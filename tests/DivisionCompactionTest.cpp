@@ -0,0 +1,107 @@
+/*
+ * Regression test for the division schedule across table compaction.
+ *
+ * Two dividing cells are kept below their minimum division volume, so the
+ * schedule requeues them every MCS. The cell in the lower slot is then
+ * killed, retired and compacted away, which moves the other cell down a
+ * slot and shrinks the table. Entries left in the schedule for the old
+ * last slot must not be acted on. Built with _GLIBCXX_ASSERTIONS, so an
+ * out-of-bounds read of the cell table aborts the test.
+ *
+ * Usage: DivisionCompactionTest
+ */
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../src/headers/CellType.h"
+#include "../src/headers/DivisionHandler.h"
+#include "../src/headers/LifecycleHandler.h"
+#include "../src/headers/RandomNumberGenerators.h"
+#include "../src/headers/SimClock.h"
+#include "../src/headers/SquareCellGrid.h"
+#include "../src/headers/SuperCell.h"
+
+static const int GRID_SIDE = 40;
+static const int CELL_SIDE = 4;
+
+int main() {
+
+	RandomNumberGenerators::setSeed(1);
+
+	// Boundary, medium, and a dividing type that needs more volume than its cells have
+	for (int t = 0; t < 3; t++) {
+
+		CellType T(t);
+		T.J = std::vector<double>(3, 10.0);
+		T.isStatic = (t == 0);
+		T.ignoreVolume = (t <= 1);
+
+		if (t == 2) {
+			T.doesDivide = true;
+			T.divMinVolume = 100;
+		}
+
+		CellType::addType(T);
+	}
+
+	CellType::buildJTable();
+
+	int boundarySuper = SuperCell::makeNewSuperCell(0, 0, 0);
+	int spaceSuper = SuperCell::makeNewSuperCell(1, 0, 0);
+
+	auto grid = std::make_shared<SquareCellGrid>(GRID_SIDE, GRID_SIDE, boundarySuper, spaceSuper);
+
+	int cells[2];
+	for (int k = 0; k < 2; k++) {
+
+		cells[k] = SuperCell::makeNewSuperCell(2, 0, CELL_SIDE * CELL_SIDE);
+		SuperCell::setNextDiv(cells[k], 0);
+
+		const int x0 = 5 + 10 * k;
+		for (int y = 5; y < 5 + CELL_SIDE; y++) {
+			for (int x = x0; x < x0 + CELL_SIDE; x++) {
+				grid->setCell(x, y, cells[k]);
+			}
+		}
+	}
+
+	DivisionHandler::initializeHandler(grid);
+	LifecycleHandler::initializeHandler(grid, 1);
+
+	const int survivorID = SuperCell::getID(cells[1]);
+
+	for (int m = 0; m < 10; m++) {
+
+		// Kill the first cell once both are being requeued, and clear its sites so it retires
+		if (m == 3) {
+
+			SuperCell::setDead(cells[0], true);
+
+			for (int y = 5; y < 5 + CELL_SIDE; y++) {
+				for (int x = 5; x < 5 + CELL_SIDE; x++) {
+					grid->setCell(x, y, spaceSuper);
+				}
+			}
+		}
+
+		LifecycleHandler::runLifecycleLoop(m);
+		DivisionHandler::runDivisionLoop();
+		SimClock::tick();
+	}
+
+	if (SuperCell::getNumSupers() != 3) {
+		std::cerr << "FAIL: expected 3 cells after compaction, found " << SuperCell::getNumSupers() << "\n";
+		return 1;
+	}
+
+	if (SuperCell::getID(2) != survivorID || SuperCell::isDead(2)) {
+		std::cerr << "FAIL: surviving cell was not compacted into slot 2\n";
+		return 1;
+	}
+
+	std::cout << "PASS\n";
+
+	return 0;
+}